@@ -0,0 +1,282 @@
+// Convert a BDF font to the .olf format FontFile reads (see font_file.h)
+//
+// bdf2olf [-r ranges] [-d default_cp] in.bdf out.olf
+//
+// -r keeps only the listed code points, e.g. -r 0x20-0x7e,0xb0,0xb5,0x2190-0x2193
+// -d sets the glyph drawn for missing code points (default '?')
+
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+struct Glyph {
+    uint32_t cp;
+    int width;
+    int height;
+    int x_off;  // from pen to left of bitmap
+    int y_off;  // from top of line to top of bitmap
+    int advance;
+    std::vector<uint8_t> bits;  // bands, LSB on top
+};
+
+
+struct Range {
+    uint32_t lo;
+    uint32_t hi;
+};
+
+
+static bool parse_ranges(const char *s, std::vector<Range>& ranges)
+{
+    while (*s != '\0') {
+        char *end;
+        Range r;
+        r.lo = strtoul(s, &end, 0);
+        if (end == s)
+            return false;
+        r.hi = r.lo;
+        s = end;
+        if (*s == '-') {
+            s++;
+            r.hi = strtoul(s, &end, 0);
+            if (end == s)
+                return false;
+            s = end;
+        }
+        ranges.push_back(r);
+        if (*s == ',')
+            s++;
+        else if (*s != '\0')
+            return false;
+    }
+    return true;
+}
+
+
+static bool wanted(uint32_t cp, const std::vector<Range>& ranges)
+{
+    if (ranges.empty())
+        return true;
+    for (const Range& r : ranges)
+        if (cp >= r.lo && cp <= r.hi)
+            return true;
+    return false;
+}
+
+
+static bool starts(const char *line, const char *word)
+{
+    const size_t n = strlen(word);
+    return strncmp(line, word, n) == 0 && (line[n] == ' ' || line[n] == '\n' ||
+                                           line[n] == '\r' || line[n] == '\0');
+}
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-r ranges] [-d default_cp] in.bdf out.olf\n", prog);
+    exit(1);
+}
+
+
+static void put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(uint8_t(v >> (8 * i)));
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::vector<Range> ranges;
+    uint32_t default_cp = '?';
+
+    const char *optstr = "r:d:";
+    int opt;
+    while ((opt = getopt(argc, argv, optstr)) != -1) {
+        switch (opt) {
+            case 'r':
+                if (!parse_ranges(optarg, ranges))
+                    usage(argv[0]);
+                break;
+            case 'd':
+                default_cp = strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (argc - optind != 2)
+        usage(argv[0]);
+
+    const char *in_name = argv[optind];
+    const char *out_name = argv[optind + 1];
+
+    FILE *in = fopen(in_name, "r");
+    if (in == nullptr) {
+        perror(in_name);
+        return 1;
+    }
+
+    int ascent = -1;
+    int descent = -1;
+    int bbx_h = 0;
+    int bbx_yoff = 0;
+
+    // per glyph, in BDF terms: baseline-relative, y up
+    std::vector<Glyph> glyphs;
+    bool in_char = false;
+    bool skip = false;
+    int rows_left = 0;
+    int bdf_w = 0, bdf_h = 0, bdf_xo = 0, bdf_yo = 0, dwidth = 0;
+    long encoding = -1;
+    std::vector<std::string> bitmap;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), in) != nullptr) {
+        if (rows_left > 0) {
+            bitmap.push_back(line);
+            rows_left--;
+            continue;
+        }
+
+        if (!in_char) {
+            if (starts(line, "FONTBOUNDINGBOX")) {
+                int w, xo;
+                sscanf(line, "FONTBOUNDINGBOX %d %d %d %d", &w, &bbx_h, &xo, &bbx_yoff);
+            } else if (starts(line, "FONT_ASCENT")) {
+                sscanf(line, "FONT_ASCENT %d", &ascent);
+            } else if (starts(line, "FONT_DESCENT")) {
+                sscanf(line, "FONT_DESCENT %d", &descent);
+            } else if (starts(line, "STARTCHAR")) {
+                in_char = true;
+                skip = false;
+                encoding = -1;
+                dwidth = 0;
+                bdf_w = bdf_h = bdf_xo = bdf_yo = 0;
+                bitmap.clear();
+            }
+            continue;
+        }
+
+        if (starts(line, "ENCODING")) {
+            sscanf(line, "ENCODING %ld", &encoding);
+            skip = encoding < 0 || !wanted(uint32_t(encoding), ranges);
+        } else if (starts(line, "DWIDTH")) {
+            sscanf(line, "DWIDTH %d", &dwidth);
+        } else if (starts(line, "BBX")) {
+            sscanf(line, "BBX %d %d %d %d", &bdf_w, &bdf_h, &bdf_xo, &bdf_yo);
+        } else if (starts(line, "BITMAP")) {
+            rows_left = bdf_h;
+        } else if (starts(line, "ENDCHAR")) {
+            in_char = false;
+            if (skip)
+                continue;
+            if (bdf_w > 255 || bdf_h > 255 || dwidth > 255 || dwidth < 0) {
+                fprintf(stderr, "%s: glyph %ld too big, skipped\n", in_name, encoding);
+                continue;
+            }
+            Glyph g;
+            g.cp = uint32_t(encoding);
+            g.width = bdf_w;
+            g.height = bdf_h;
+            g.x_off = bdf_xo;
+            g.y_off = bdf_yo; // fixed up below, once ascent is known
+            g.advance = dwidth;
+            g.bits.assign(size_t((bdf_h + 7) / 8) * bdf_w, 0);
+            for (int y = 0; y < bdf_h && y < int(bitmap.size()); y++) {
+                const std::string& hex = bitmap[y];
+                for (int x = 0; x < bdf_w && size_t(x / 4) < hex.size(); x++) {
+                    const char h[2] = { hex[x / 4], '\0' };
+                    const int nib = strtol(h, nullptr, 16);
+                    if (nib & (8 >> (x % 4)))
+                        g.bits[(y / 8) * bdf_w + x] |= (1 << (y % 8));
+                }
+            }
+            glyphs.push_back(std::move(g));
+        }
+    }
+
+    fclose(in);
+
+    if (ascent < 0)
+        ascent = bbx_h + bbx_yoff;
+    if (descent < 0)
+        descent = -bbx_yoff;
+
+    const int height = ascent + descent;
+    if (ascent < 0 || ascent > 255 || height <= 0 || height > 255) {
+        fprintf(stderr, "%s: no usable FONT_ASCENT/FONT_DESCENT\n", in_name);
+        return 1;
+    }
+
+    if (glyphs.empty()) {
+        fprintf(stderr, "%s: no glyphs\n", in_name);
+        return 1;
+    }
+
+    // BBX y offset is from the baseline up to the bottom of the bitmap
+    for (Glyph& g : glyphs) {
+        g.y_off = ascent - (g.y_off + g.height);
+        if (g.x_off < -128 || g.x_off > 127 || g.y_off < -128 || g.y_off > 127) {
+            fprintf(stderr, "%s: glyph %u offset out of range\n", in_name, unsigned(g.cp));
+            return 1;
+        }
+    }
+
+    std::sort(glyphs.begin(), glyphs.end(),
+              [](const Glyph& a, const Glyph& b) { return a.cp < b.cp; });
+    glyphs.erase(std::unique(glyphs.begin(), glyphs.end(),
+                             [](const Glyph& a, const Glyph& b) { return a.cp == b.cp; }),
+                 glyphs.end());
+
+    std::vector<uint8_t> out;
+
+    out.insert(out.end(), { 'O', 'L', 'F', '1' });
+    put32(out, glyphs.size());
+    out.push_back(uint8_t(height));
+    out.push_back(uint8_t(ascent));
+    out.push_back(0);
+    out.push_back(0);
+    put32(out, default_cp);
+
+    uint32_t offset = out.size() + glyphs.size() * 8;
+    for (const Glyph& g : glyphs) {
+        put32(out, g.cp);
+        put32(out, offset);
+        offset += 6 + g.bits.size();
+    }
+
+    for (const Glyph& g : glyphs) {
+        out.push_back(uint8_t(g.width));
+        out.push_back(uint8_t(g.height));
+        out.push_back(uint8_t(int8_t(g.x_off)));
+        out.push_back(uint8_t(int8_t(g.y_off)));
+        out.push_back(uint8_t(g.advance));
+        out.push_back(0);
+        out.insert(out.end(), g.bits.begin(), g.bits.end());
+    }
+
+    FILE *f = fopen(out_name, "wb");
+    if (f == nullptr) {
+        perror(out_name);
+        return 1;
+    }
+    if (fwrite(out.data(), 1, out.size(), f) != out.size() || fclose(f) != 0) {
+        perror(out_name);
+        return 1;
+    }
+
+    printf("%s: %zu glyphs, height %d, ascent %d, %zu bytes\n",
+           out_name, glyphs.size(), height, ascent, out.size());
+
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "display_list.h"
+#include "font_file.h"
+#include "ssd1306_128x64.h"
+
+
+DisplayList::DisplayList()
+{
+}
+
+
+void DisplayList::reset()
+{
+    _ops.clear();
+}
+
+
+void DisplayList::op(Op o)
+{
+    _ops.push_back(o);
+}
+
+
+void DisplayList::i16(int v)
+{
+    // out-of-range coordinates are clipped anyway; keep them off-screen
+    if (v < INT16_MIN) v = INT16_MIN;
+    if (v > INT16_MAX) v = INT16_MAX;
+    _ops.push_back(uint8_t(v));
+    _ops.push_back(uint8_t(v >> 8));
+}
+
+
+void DisplayList::u8(uint8_t v)
+{
+    _ops.push_back(v);
+}
+
+
+void DisplayList::ptr(const void *p)
+{
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(&p);
+    _ops.insert(_ops.end(), b, b + sizeof(p));
+}
+
+
+void DisplayList::str(const char *s)
+{
+    _ops.insert(_ops.end(), s, s + strlen(s) + 1);
+}
+
+
+void DisplayList::clear()
+{
+    op(op_clear);
+}
+
+
+void DisplayList::viewport(int x, int y, int w, int h)
+{
+    op(op_viewport);
+    i16(x);
+    i16(y);
+    i16(w);
+    i16(h);
+}
+
+
+void DisplayList::clip(int x1, int y1, int x2, int y2)
+{
+    op(op_clip);
+    i16(x1);
+    i16(y1);
+    i16(x2);
+    i16(y2);
+}
+
+
+void DisplayList::reset_viewport()
+{
+    op(op_reset_viewport);
+}
+
+
+void DisplayList::set(int x, int y, int d)
+{
+    op(op_set);
+    i16(x);
+    i16(y);
+    u8(d != 0);
+}
+
+
+void DisplayList::putc(int col, int row, char c, uint8_t font[128][5])
+{
+    op(op_putc);
+    i16(col);
+    i16(row);
+    u8(c);
+    ptr(font);
+}
+
+
+void DisplayList::puts(int col, int row, const char *s, uint8_t font[128][5])
+{
+    op(op_puts);
+    i16(col);
+    i16(row);
+    ptr(font);
+    str(s);
+}
+
+
+void DisplayList::putc2(int col, int row, char c, uint8_t font[128][5])
+{
+    op(op_putc2);
+    i16(col);
+    i16(row);
+    u8(c);
+    ptr(font);
+}
+
+
+void DisplayList::puts2(int col, int row, const char *s, uint8_t font[128][5])
+{
+    op(op_puts2);
+    i16(col);
+    i16(row);
+    ptr(font);
+    str(s);
+}
+
+
+void DisplayList::putc_at(int x, int y, char c, uint8_t font[128][5])
+{
+    op(op_putc_at);
+    i16(x);
+    i16(y);
+    u8(c);
+    ptr(font);
+}
+
+
+void DisplayList::puts_at(int x, int y, const char *s, uint8_t font[128][5])
+{
+    op(op_puts_at);
+    i16(x);
+    i16(y);
+    ptr(font);
+    str(s);
+}
+
+
+void DisplayList::puts_at(int x, int y, const char *s, const FontFile& font)
+{
+    op(op_puts_at_file);
+    i16(x);
+    i16(y);
+    ptr(&font);
+    str(s);
+}
+
+
+void DisplayList::hline(int x1, int x2, int y)
+{
+    op(op_hline);
+    i16(x1);
+    i16(x2);
+    i16(y);
+}
+
+
+void DisplayList::vline(int x, int y1, int y2)
+{
+    op(op_vline);
+    i16(x);
+    i16(y1);
+    i16(y2);
+}
+
+
+void DisplayList::box(int x1, int y1, int x2, int y2)
+{
+    op(op_box);
+    i16(x1);
+    i16(y1);
+    i16(x2);
+    i16(y2);
+}
+
+
+void DisplayList::fill(int x1, int y1, int x2, int y2, int d)
+{
+    op(op_fill);
+    i16(x1);
+    i16(y1);
+    i16(x2);
+    i16(y2);
+    u8(d != 0);
+}
+
+
+namespace {
+
+// Reading back what the recording functions wrote
+class Reader
+{
+  public:
+
+    Reader(const uint8_t *p) : _p(p) { }
+
+    int i16()
+    {
+        const int16_t v = int16_t(_p[0] | (_p[1] << 8));
+        _p += 2;
+        return v;
+    }
+
+    uint8_t u8()
+    {
+        return *_p++;
+    }
+
+    template <typename T>
+    T ptr()
+    {
+        T p;
+        memcpy(&p, _p, sizeof(p));
+        _p += sizeof(p);
+        return p;
+    }
+
+    // used in place, no copy
+    const char *str()
+    {
+        const char *s = reinterpret_cast<const char *>(_p);
+        _p += strlen(s) + 1;
+        return s;
+    }
+
+    const uint8_t *pos() const { return _p; }
+
+  private:
+
+    const uint8_t *_p;
+};
+
+typedef uint8_t (*Font5x7)[5];
+
+} // namespace
+
+
+void DisplayList::replay(Ssd1306_128x64& oled) const
+{
+    Reader r(_ops.data());
+    const uint8_t *end = _ops.data() + _ops.size();
+
+    while (r.pos() < end) {
+        // each argument is read in its own statement so the order is defined
+        const Op o = Op(r.u8());
+        switch (o) {
+            case op_clear:
+                oled.clear();
+                break;
+            case op_viewport: {
+                const int x = r.i16();
+                const int y = r.i16();
+                const int w = r.i16();
+                const int h = r.i16();
+                oled.viewport(x, y, w, h);
+                break;
+            }
+            case op_clip: {
+                const int x1 = r.i16();
+                const int y1 = r.i16();
+                const int x2 = r.i16();
+                const int y2 = r.i16();
+                oled.clip(x1, y1, x2, y2);
+                break;
+            }
+            case op_reset_viewport:
+                oled.reset_viewport();
+                break;
+            case op_set: {
+                const int x = r.i16();
+                const int y = r.i16();
+                const int d = r.u8();
+                oled.set(x, y, d);
+                break;
+            }
+            case op_putc:
+            case op_putc2:
+            case op_putc_at: {
+                const int x = r.i16();
+                const int y = r.i16();
+                const char c = char(r.u8());
+                Font5x7 font = r.ptr<Font5x7>();
+                if (o == op_putc)
+                    oled.putc(x, y, c, font);
+                else if (o == op_putc2)
+                    oled.putc2(x, y, c, font);
+                else
+                    oled.putc_at(x, y, c, font);
+                break;
+            }
+            case op_puts:
+            case op_puts2:
+            case op_puts_at: {
+                const int x = r.i16();
+                const int y = r.i16();
+                Font5x7 font = r.ptr<Font5x7>();
+                const char *s = r.str();
+                if (o == op_puts)
+                    oled.puts(x, y, s, font);
+                else if (o == op_puts2)
+                    oled.puts2(x, y, s, font);
+                else
+                    oled.puts_at(x, y, s, font);
+                break;
+            }
+            case op_puts_at_file: {
+                const int x = r.i16();
+                const int y = r.i16();
+                const FontFile *font = r.ptr<const FontFile *>();
+                const char *s = r.str();
+                oled.puts_at(x, y, s, *font);
+                break;
+            }
+            case op_hline: {
+                const int x1 = r.i16();
+                const int x2 = r.i16();
+                const int y = r.i16();
+                oled.hline(x1, x2, y);
+                break;
+            }
+            case op_vline: {
+                const int x = r.i16();
+                const int y1 = r.i16();
+                const int y2 = r.i16();
+                oled.vline(x, y1, y2);
+                break;
+            }
+            case op_box: {
+                const int x1 = r.i16();
+                const int y1 = r.i16();
+                const int x2 = r.i16();
+                const int y2 = r.i16();
+                oled.box(x1, y1, x2, y2);
+                break;
+            }
+            case op_fill: {
+                const int x1 = r.i16();
+                const int y1 = r.i16();
+                const int x2 = r.i16();
+                const int y2 = r.i16();
+                const int d = r.u8();
+                oled.fill(x1, y1, x2, y2, d);
+                break;
+            }
+        }
+    }
+}
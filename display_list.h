@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FontFile;
+class Ssd1306_128x64;
+
+
+// Recorded drawing operations
+//
+// A DisplayList has the same drawing calls as Ssd1306_128x64, but records
+// them instead of drawing. replay() then runs them against a display. Lists
+// are how other threads hand drawing to a Renderer (renderer.h), and a list
+// for a screen that doesn't change can be recorded once and replayed as
+// often as needed without running the code that built it.
+//
+// The encoding is a byte per operation followed by its arguments:
+// coordinates are int16 and strings are copied in with their nul, so replay
+// uses them in place. Fonts are recorded by pointer and must outlive the
+// list.
+
+class DisplayList
+{
+  public:
+
+    DisplayList();
+
+    void reset();
+    bool empty() const { return _ops.empty(); }
+    size_t size() const { return _ops.size(); }
+
+    void replay(Ssd1306_128x64& oled) const;
+
+    void clear();
+    void viewport(int x, int y, int w, int h);
+    void clip(int x1, int y1, int x2, int y2);
+    void reset_viewport();
+    void set(int x, int y, int d=1);
+    void putc(int col, int row, char c, uint8_t font[128][5]);
+    void puts(int col, int row, const char *s, uint8_t font[128][5]);
+    void putc2(int col, int row, char c, uint8_t font[128][5]);
+    void puts2(int col, int row, const char *s, uint8_t font[128][5]);
+    void putc_at(int x, int y, char c, uint8_t font[128][5]);
+    void puts_at(int x, int y, const char *s, uint8_t font[128][5]);
+    void puts_at(int x, int y, const char *s, const FontFile& font);
+    void hline(int x1, int x2, int y);
+    void vline(int x, int y1, int y2);
+    void box(int x1, int y1, int x2, int y2);
+    void fill(int x1, int y1, int x2, int y2, int d=1);
+
+  private:
+
+    enum Op : uint8_t {
+        op_clear,
+        op_viewport,
+        op_clip,
+        op_reset_viewport,
+        op_set,
+        op_putc,
+        op_puts,
+        op_putc2,
+        op_puts2,
+        op_putc_at,
+        op_puts_at,
+        op_puts_at_file,
+        op_hline,
+        op_vline,
+        op_box,
+        op_fill,
+    };
+
+    std::vector<uint8_t> _ops;
+
+    void op(Op o);
+    void i16(int v);
+    void u8(uint8_t v);
+    void ptr(const void *p);
+    void str(const char *s);
+};
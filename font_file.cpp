@@ -0,0 +1,177 @@
+#include <cstdint>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "font_file.h"
+
+
+static const size_t header_len = 16;
+
+
+FontFile::FontFile(const char *path) :
+    _map(nullptr),
+    _map_len(0),
+    _index(nullptr),
+    _count(0),
+    _height(0),
+    _ascent(0),
+    _default(nullptr)
+{
+    memset(_ascii, 0, sizeof(_ascii));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < header_len) {
+        close(fd);
+        return;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (map == MAP_FAILED)
+        return;
+
+    _map = static_cast<const uint8_t *>(map);
+    _map_len = st.st_size;
+
+    if (!check()) {
+        munmap(map, _map_len);
+        _map = nullptr;
+        _map_len = 0;
+        _index = nullptr;
+        _count = 0;
+        return;
+    }
+
+    uint32_t default_cp;
+    memcpy(&default_cp, _map + 12, sizeof(default_cp));
+    _height = _map[8];
+    _ascent = _map[9];
+
+    for (uint32_t cp = 0; cp < 128; cp++)
+        _ascii[cp] = search(cp);
+
+    _default = search(default_cp);
+}
+
+
+FontFile::~FontFile()
+{
+    if (_map != nullptr) {
+        munmap(const_cast<uint8_t *>(_map), _map_len);
+        _map = nullptr;
+    }
+}
+
+
+// Validate everything once, so find() can trust what it reads; on success
+// set up _index and _count
+bool FontFile::check()
+{
+    if (memcmp(_map, "OLF1", 4) != 0)
+        return false;
+
+    uint32_t count;
+    memcpy(&count, _map + 4, sizeof(count));
+
+    if (count > (_map_len - header_len) / sizeof(Index))
+        return false;
+
+    const Index *index = reinterpret_cast<const Index *>(_map + header_len);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0 && index[i].cp <= index[i - 1].cp)
+            return false; // not sorted
+        const uint32_t off = index[i].offset;
+        if (off > _map_len - sizeof(Glyph))
+            return false;
+        const Glyph *g = reinterpret_cast<const Glyph *>(_map + off);
+        const size_t bits_len = size_t((g->height + 7) / 8) * g->width;
+        if (bits_len > _map_len - off - sizeof(Glyph))
+            return false;
+    }
+
+    _index = index;
+    _count = count;
+
+    return true;
+}
+
+
+const FontFile::Glyph *FontFile::search(uint32_t cp) const
+{
+    uint32_t lo = 0;
+    uint32_t hi = _count;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (_index[mid].cp < cp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < _count && _index[lo].cp == cp)
+        return reinterpret_cast<const Glyph *>(_map + _index[lo].offset);
+
+    return nullptr;
+}
+
+
+const FontFile::Glyph *FontFile::find(uint32_t cp) const
+{
+    const Glyph *g = (cp < 128) ? _ascii[cp] : search(cp);
+    return (g != nullptr) ? g : _default;
+}
+
+
+uint32_t utf8_next(const char *&s)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(s);
+    const uint32_t bad = 0xfffd;
+
+    uint32_t cp;
+    int more;
+    if (p[0] < 0x80) {
+        s++;
+        return p[0];
+    } else if ((p[0] & 0xe0) == 0xc0) {
+        cp = p[0] & 0x1f;
+        more = 1;
+    } else if ((p[0] & 0xf0) == 0xe0) {
+        cp = p[0] & 0x0f;
+        more = 2;
+    } else if ((p[0] & 0xf8) == 0xf0) {
+        cp = p[0] & 0x07;
+        more = 3;
+    } else {
+        s++;
+        return bad;
+    }
+
+    for (int i = 1; i <= more; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            // truncated (this also stops at the nul)
+            s++;
+            return bad;
+        }
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+
+    // overlong encodings and surrogates
+    static const uint32_t min_cp[4] = { 0, 0x80, 0x800, 0x10000 };
+    if (cp < min_cp[more] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        s++;
+        return bad;
+    }
+
+    s += more + 1;
+    return cp;
+}
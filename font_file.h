@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Font file (.olf), memory-mapped read-only
+//
+// Glyphs are variable size and proportional, and are looked up by Unicode
+// code point, so a font can carry just the characters a program needs
+// (degree sign, micro, arrows, a few non-Latin labels) without compiling
+// tables into every binary. bdf2olf makes these from BDF fonts.
+//
+// Everything is little-endian, and the header and index are 4-byte aligned
+// so the index can be used in place.
+//
+// Header (16 bytes):
+//   char     magic[4]    "OLF1"
+//   uint32   count       number of glyphs
+//   uint8    height      line height, pixels
+//   uint8    ascent      baseline, pixels down from top of line
+//   uint16   reserved
+//   uint32   default_cp  drawn for code points not in the font (if it is)
+//
+// Index (count * 8 bytes), sorted by code point:
+//   uint32   cp
+//   uint32   offset      from start of file to the glyph
+//
+// Glyph (6 bytes, then the bitmap):
+//   uint8    width       bitmap columns
+//   uint8    height      bitmap rows
+//   int8     x_off       pen position to left edge of bitmap
+//   int8     y_off       top of line to top of bitmap
+//   uint8    advance     pen moves this far after the glyph
+//   uint8    reserved
+//   uint8    bits[]      (height + 7) / 8 bands of width bytes, each byte
+//                        8 vertical pixels with the LSB on top, the same
+//                        layout as the display
+
+class FontFile
+{
+  public:
+
+    struct Glyph {
+        uint8_t width;
+        uint8_t height;
+        int8_t x_off;
+        int8_t y_off;
+        uint8_t advance;
+        uint8_t reserved;
+
+        // bitmap follows the header
+        const uint8_t *bits() const
+        {
+            return reinterpret_cast<const uint8_t *>(this) + sizeof(Glyph);
+        }
+    };
+
+    // if the file can't be opened or doesn't look right, ok() is false and
+    // find() always returns nullptr
+    explicit FontFile(const char *path);
+    ~FontFile();
+
+    FontFile(const FontFile&) = delete;
+    FontFile& operator=(const FontFile&) = delete;
+
+    bool ok() const { return _map != nullptr; }
+
+    int height() const { return _height; }
+    int ascent() const { return _ascent; }
+
+    // glyph for cp, or the default glyph, or nullptr
+    const Glyph *find(uint32_t cp) const;
+
+  private:
+
+    struct Index {
+        uint32_t cp;
+        uint32_t offset;
+    };
+
+    const uint8_t *_map;
+    size_t _map_len;
+
+    const Index *_index;
+    uint32_t _count;
+
+    int _height;
+    int _ascent;
+
+    const Glyph *_default;
+
+    // ASCII is looked up directly; everything else is a binary search
+    const Glyph *_ascii[128];
+
+    const Glyph *search(uint32_t cp) const;
+    bool check();
+};
+
+
+// Decode one UTF-8 character from s and advance s past it. Malformed input
+// decodes as U+FFFD one byte at a time. Don't call at the terminating nul.
+uint32_t utf8_next(const char *&s);
@@ -0,0 +1,220 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+#include "i2c_bus.h"
+#include "trace.h"
+
+
+// i2c-dev refuses messages longer than this
+static const int rdwr_msg_max = 8192;
+
+
+// Controllers whose drivers take less than i2c-dev allows. Matched against
+// the start of /sys/class/i2c-dev/i2c-N/name; add to this as boards turn up.
+static const struct {
+    const char *name;
+    int max_msg;    // data bytes, not counting the register address
+    int max_msgs;
+} known[] = {
+    { "CP2112", 61 - 1, 1 },    // one write of up to 61 bytes per transfer
+};
+
+
+I2cBus::I2cBus(const char *i2c_dev) :
+    _i2c_fd(-1),
+    _smbus(false),
+    _max_msg(0),
+    _max_msgs(0),
+    _busy(false),
+    _waiting{0, 0, 0}
+{
+    _i2c_fd = open(i2c_dev, O_RDWR);
+    if (_i2c_fd < 0)
+        return;
+
+    limits(i2c_dev);
+}
+
+
+I2cBus::I2cBus(int max_msg, int max_msgs) :
+    _i2c_fd(-1),
+    _smbus(false),
+    _max_msg(max_msg),
+    _max_msgs(max_msgs),
+    _busy(false),
+    _waiting{0, 0, 0}
+{
+    if (max_msg <= 0 || max_msgs <= 0) {
+        _max_msg = 0;
+        return;
+    }
+
+    if (_max_msg > rdwr_msg_max - 1)
+        _max_msg = rdwr_msg_max - 1;
+    if (_max_msgs > I2C_RDWR_IOCTL_MAX_MSGS)
+        _max_msgs = I2C_RDWR_IOCTL_MAX_MSGS;
+}
+
+
+I2cBus::~I2cBus()
+{
+    if (_i2c_fd >= 0) {
+        close(_i2c_fd);
+        _i2c_fd = -1;
+    }
+}
+
+
+// Work out _max_msg and _max_msgs for the adapter behind _i2c_fd
+void I2cBus::limits(const char *i2c_dev)
+{
+    _max_msg = rdwr_msg_max - 1;
+    _max_msgs = I2C_RDWR_IOCTL_MAX_MSGS;
+
+    unsigned long funcs = 0;
+    if (ioctl(_i2c_fd, I2C_FUNCS, &funcs) < 0)
+        funcs = I2C_FUNC_I2C; // can't tell; assume the usual
+
+    if (!(funcs & I2C_FUNC_I2C)) {
+        if (!(funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)) {
+            _max_msg = 0; // nothing we can use
+            return;
+        }
+        _smbus = true;
+        _max_msg = I2C_SMBUS_BLOCK_MAX;
+        _max_msgs = 1;
+    }
+
+    // /dev/i2c-1 -> /sys/class/i2c-dev/i2c-1/name
+    const char *base = strrchr(i2c_dev, '/');
+    base = (base != nullptr) ? base + 1 : i2c_dev;
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/class/i2c-dev/%s/name", base);
+    FILE *f = fopen(path, "r");
+    if (f != nullptr) {
+        char name[128];
+        if (fgets(name, sizeof(name), f) != nullptr) {
+            for (const auto& k : known) {
+                if (strncmp(name, k.name, strlen(k.name)) == 0) {
+                    if (k.max_msg < _max_msg)
+                        _max_msg = k.max_msg;
+                    if (k.max_msgs < _max_msgs)
+                        _max_msgs = k.max_msgs;
+                }
+            }
+        }
+        fclose(f);
+    }
+}
+
+
+int I2cBus::transfer(i2c_msg *msgs, int nmsgs, Priority priority)
+{
+    if (!ok())
+        return -1;
+
+    acquire(priority);
+    const int r = xfer(msgs, nmsgs);
+    release();
+
+    return r;
+}
+
+
+// Wait until the bus is free and nothing of higher priority is waiting
+void I2cBus::acquire(Priority priority)
+{
+    OLED_TRACE_SCOPE(t, "i2c_wait");
+    OLED_TRACE_ARG(t, "priority", priority);
+
+    const int p = int(priority);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waiting[p]++;
+    _free.wait(lock, [this, p]() {
+        if (_busy)
+            return false;
+        for (int q = p + 1; q < 3; q++)
+            if (_waiting[q] > 0)
+                return false;
+        return true;
+    });
+    _waiting[p]--;
+    _busy = true;
+}
+
+
+void I2cBus::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _busy = false;
+    }
+    // everyone, so the highest priority waiter gets a look
+    _free.notify_all();
+}
+
+
+int I2cBus::xfer(i2c_msg *msgs, int nmsgs)
+{
+    if (_smbus)
+        return xfer_smbus(msgs, nmsgs);
+
+    i2c_rdwr_ioctl_data rdwr = { msgs, uint32_t(nmsgs) };
+    return ioctl(_i2c_fd, I2C_RDWR, &rdwr);
+}
+
+
+// The messages I2cDev's read() and write() make, as SMBus I2C block
+// transfers: a write message is a block write with its first byte as the
+// command, and a write of one byte followed by a read is a block read.
+int I2cBus::xfer_smbus(i2c_msg *msgs, int nmsgs)
+{
+    // the slave address sticks to the fd, and other devices use it too
+    if (nmsgs < 1 || ioctl(_i2c_fd, I2C_SLAVE, msgs[0].addr) < 0)
+        return -1;
+
+    i2c_smbus_data data;
+    i2c_smbus_ioctl_data args;
+
+    for (int i = 0; i < nmsgs; i++) {
+        const i2c_msg& m = msgs[i];
+
+        if (m.flags & I2C_M_RD)
+            return -1; // only as the second of a pair, below
+
+        if (i + 1 < nmsgs && (msgs[i + 1].flags & I2C_M_RD)) {
+            const i2c_msg& r = msgs[i + 1];
+            if (m.len != 1 || r.len > I2C_SMBUS_BLOCK_MAX)
+                return -1;
+            data.block[0] = r.len;
+            args = { I2C_SMBUS_READ, m.buf[0], I2C_SMBUS_I2C_BLOCK_DATA, &data };
+            if (ioctl(_i2c_fd, I2C_SMBUS, &args) < 0)
+                return -1;
+            memcpy(r.buf, &data.block[1], r.len);
+            i++;
+            continue;
+        }
+
+        if (m.len < 1 || m.len - 1 > I2C_SMBUS_BLOCK_MAX)
+            return -1;
+        data.block[0] = m.len - 1;
+        memcpy(&data.block[1], &m.buf[1], m.len - 1);
+        args = { I2C_SMBUS_WRITE, m.buf[0], I2C_SMBUS_I2C_BLOCK_DATA, &data };
+        if (ioctl(_i2c_fd, I2C_SMBUS, &args) < 0)
+            return -1;
+    }
+
+    return nmsgs;
+}
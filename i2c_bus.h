@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+struct i2c_msg;
+
+
+// One i2c adapter (/dev/i2c-N), shared by any number of I2cDevs
+//
+// Every transfer (one I2C_RDWR ioctl) holds the bus by itself. Transfers
+// waiting for the bus go in priority order: while a High transfer is
+// waiting, no Normal or Low one starts, and so on. Nothing is preempted,
+// so a High transfer waits for at most the one transfer in progress. That
+// is why a device that sends a lot (a display) should be given a slice
+// (see I2cDev): its writes are then sent as many short transfers, and a
+// sensor read can get in between any two of them instead of waiting out
+// a whole frame.
+//
+// Transfers of the same priority go in no particular order, and a steady
+// stream of higher priority transfers starves lower ones; give High to
+// short, periodic transfers only.
+
+class I2cBus {
+
+    public:
+
+        enum class Priority { Low, Normal, High };
+
+        I2cBus(const char *i2c_dev);
+
+        virtual ~I2cBus();
+
+        I2cBus(const I2cBus&) = delete;
+        I2cBus& operator=(const I2cBus&) = delete;
+
+        // false if the adapter could not be opened, or can't do anything
+        // I2cDev needs
+        bool ok() const { return _max_msg > 0; }
+
+        // data bytes per message (not counting the register address), and
+        // messages per ioctl, that the adapter takes
+        int max_msg() const { return _max_msg; }
+        int max_msgs() const { return _max_msgs; }
+
+        // Wait for the bus, then do one transfer; returns < 0 on failure
+        int transfer(i2c_msg *msgs, int nmsgs, Priority priority);
+
+    protected:
+
+        // No adapter; for stand-ins that override xfer()
+        I2cBus(int max_msg, int max_msgs);
+
+        // One I2C_RDWR ioctl, with the bus held
+        virtual int xfer(i2c_msg *msgs, int nmsgs);
+
+    private:
+
+        int _i2c_fd;
+
+        // adapter only does SMBus; xfer() translates to I2C_SMBUS
+        bool _smbus;
+
+        int _max_msg;
+        int _max_msgs;
+
+        // arbitration: _busy while a transfer is in progress, and how many
+        // are waiting at each priority
+        std::mutex _mutex;
+        std::condition_variable _free;
+        bool _busy;
+        int _waiting[3];
+
+        void limits(const char *i2c_dev);
+        void acquire(Priority priority);
+        void release();
+        int xfer_smbus(i2c_msg *msgs, int nmsgs);
+};
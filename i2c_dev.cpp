@@ -1,44 +1,60 @@
-
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
-#include <unistd.h>
-
 #include <linux/i2c-dev.h>
 #include <linux/i2c.h>
 
 #include "i2c_dev.h"
+#include "trace.h"
 
 
 I2cDev::I2cDev(const char *i2c_dev, uint8_t i2c_adr, int max_msg) :
-    _i2c_fd(-1),
+    _ok(false),
+    _bus(nullptr),
+    _own_bus(false),
+    _priority(I2cBus::Priority::Normal),
     _i2c_adr(i2c_adr),
+    _max_msg(0),
+    _max_msgs(0),
     _buf_max(0),
     _buf(nullptr)
 {
-    if (max_msg <= 0)
+    if (max_msg < 0)
         return;
 
-    _i2c_fd = open(i2c_dev, O_RDWR);
-    if (_i2c_fd < 0)
+    _bus = new I2cBus(i2c_dev);
+    _own_bus = true;
+    if (!_bus->ok())
         return;
 
-    // one byte for the reg adr, then the data
-    _buf_max = max_msg + 1;
-    _buf = new uint8_t[_buf_max];
+    limits(max_msg, 0);
+}
+
+
+I2cDev::I2cDev(I2cBus& bus, uint8_t i2c_adr, I2cBus::Priority priority, int slice) :
+    _ok(false),
+    _bus(&bus),
+    _own_bus(false),
+    _priority(priority),
+    _i2c_adr(i2c_adr),
+    _max_msg(0),
+    _max_msgs(0),
+    _buf_max(0),
+    _buf(nullptr)
+{
+    if (slice < 0 || !_bus->ok())
+        return;
+
+    limits(0, slice);
 }
 
 
 I2cDev::~I2cDev()
 {
-    if (_i2c_fd >= 0) {
-        close(_i2c_fd);
-        _i2c_fd = -1;
-    }
+    if (_own_bus)
+        delete _bus;
+    _bus = nullptr;
 
     delete[] _buf;
     _buf = nullptr;
@@ -46,6 +62,31 @@ I2cDev::~I2cDev()
 }
 
 
+// Take the bus's limits, capped by max_msg (bytes per message) and slice
+// (bytes per transfer), then get ready to write
+void I2cDev::limits(int max_msg, int slice)
+{
+    _max_msg = _bus->max_msg();
+    _max_msgs = _bus->max_msgs();
+
+    if (max_msg > 0 && max_msg < _max_msg)
+        _max_msg = max_msg;
+
+    if (slice > 0) {
+        if (slice < _max_msg)
+            _max_msg = slice;
+        if (slice / _max_msg < _max_msgs)
+            _max_msgs = slice / _max_msg;
+    }
+
+    // one byte for the reg adr, then the data
+    _buf_max = _max_msg + 1;
+    _buf = new uint8_t[_buf_max];
+
+    _ok = true;
+}
+
+
 // Read buf_size bytes from reg_adr into buf
 //
 // If the read fails, retry, up to max_tries total tries.
@@ -56,7 +97,7 @@ I2cDev::~I2cDev()
 //   -1 if we get to max_tries without succeeding (or i2c device error)
 int I2cDev::read(uint8_t reg_adr, uint8_t *buf, int buf_size, int max_tries)
 {
-    if (_i2c_fd < 0)
+    if (!_ok)
         return -1;
 
     // one to send the reg adrs, one to receive the data
@@ -64,18 +105,24 @@ int I2cDev::read(uint8_t reg_adr, uint8_t *buf, int buf_size, int max_tries)
         { _i2c_adr, 0, 1, &reg_adr },
         { _i2c_adr, I2C_M_RD, uint16_t(buf_size), buf }
     };
-    i2c_rdwr_ioctl_data rdwr = { msgs, 2 };
+    int nmsgs = 2;
 
     if (buf == nullptr || buf_size == 0)
-        rdwr.nmsgs = 1; // just sending the register address, ok
+        nmsgs = 1; // just sending the register address, ok
+
+    OLED_TRACE_SCOPE(t, "i2c_read");
+    OLED_TRACE_ARG(t, "bytes", buf_size);
 
     int attempts = 0;
     while (max_tries == 0 || attempts < max_tries) {
         attempts++;
-        if (ioctl(_i2c_fd, I2C_RDWR, &rdwr) >= 0)
+        if (rdwr(msgs, nmsgs) >= 0) {
+            OLED_TRACE_ARG(t, "tries", attempts);
             return attempts;
+        }
     }
 
+    OLED_TRACE_ARG(t, "tries", -attempts); // negative: gave up
     return -1;
 }
 
@@ -86,34 +133,70 @@ int I2cDev::read(uint8_t reg_adr, uint8_t& reg_val, int max_tries)
 }
 
 
+// Write buf_size bytes from buf to reg_adr
+//
+// Anything longer than max_msg() goes as several messages, each starting
+// with reg_adr, up to max_msgs() per ioctl; max_tries applies to each ioctl.
+//
+// Returns:
+//   on success, the most tries any one ioctl needed (1 means first try)
+//   -1 if some ioctl got to max_tries without succeeding
 int I2cDev::write(uint8_t reg_adr, uint8_t *buf, int buf_size, int max_tries)
 {
-    if (_buf == nullptr || _buf_max <= 0)
+    if (!_ok)
         return -1;
 
-    if (_i2c_fd < 0)
+    if (buf_size < 0)
         return -1;
 
-    if (buf_size >= _buf_max)
-        return -1;
+    const int n_msgs = (buf_size > 0) ? (buf_size + _max_msg - 1) / _max_msg : 1;
 
-    _buf[0] = reg_adr;
-    if (buf_size > 0)
-        memcpy(&_buf[1], buf, buf_size);
-
-    i2c_msg msgs[1] = {
-        { _i2c_adr, 0, uint16_t(buf_size + 1), _buf }
-    };
-    i2c_rdwr_ioctl_data rdwr = { msgs, 1 };
+    // each message is reg_adr followed by its part of the data
+    const int need = buf_size + n_msgs;
+    if (need > _buf_max) {
+        delete[] _buf;
+        _buf_max = need;
+        _buf = new uint8_t[_buf_max];
+    }
 
-    int attempts = 0;
-    while (max_tries == 0 || attempts < max_tries) {
-        attempts++;
-        if (ioctl(_i2c_fd, I2C_RDWR, &rdwr) >= 0)
-            return attempts;
+    i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+
+    int worst = 0;
+    int done = 0;       // data bytes copied into messages
+    uint8_t *b = _buf;
+    for (int m = 0; m < n_msgs; ) {
+        OLED_TRACE_SCOPE(t, "i2c_write");
+        int nmsgs = 0;
+        for (; nmsgs < _max_msgs && m < n_msgs; nmsgs++, m++) {
+            int len = buf_size - done;
+            if (len > _max_msg)
+                len = _max_msg;
+            b[0] = reg_adr;
+            if (len > 0)
+                memcpy(&b[1], buf + done, len);
+            msgs[nmsgs] = { _i2c_adr, 0, uint16_t(len + 1), b };
+            b += len + 1;
+            done += len;
+        }
+
+        OLED_TRACE_ARG(t, "bytes", b - msgs[0].buf);
+
+        int attempts = 0;
+        while (true) {
+            if (max_tries != 0 && attempts >= max_tries) {
+                OLED_TRACE_ARG(t, "tries", -attempts); // negative: gave up
+                return -1;
+            }
+            attempts++;
+            if (rdwr(msgs, nmsgs) >= 0)
+                break;
+        }
+        OLED_TRACE_ARG(t, "tries", attempts);
+        if (attempts > worst)
+            worst = attempts;
     }
 
-    return -1;
+    return worst;
 }
 
 
@@ -121,3 +204,9 @@ int I2cDev::write(uint8_t reg_adrs, uint8_t reg_val, int max_tries)
 {
     return write(reg_adrs, &reg_val, sizeof(reg_val), max_tries);
 }
+
+
+int I2cDev::rdwr(i2c_msg *msgs, int nmsgs)
+{
+    return _bus->transfer(msgs, nmsgs, _priority);
+}
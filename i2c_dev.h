@@ -2,6 +2,10 @@
 
 #include <cstdint>
 
+#include "i2c_bus.h"
+
+struct i2c_msg;
+
 
 // Set frequency in /boot/config.txt:
 // dtparam=i2c_arm=on,i2c_arm_baudrate=400000
@@ -19,16 +23,59 @@
 //
 // Transactions appear to block in the ioctl, so the duration of a transaction is
 // roughly 9 * (number_of_bytes) / clock_freq.
+//
+// Transfer size
+//
+// On open, the adapter is asked what it can do (I2C_FUNCS), and its name is
+// checked against a table of controllers with known limits. From that comes
+// the largest message and the most messages per ioctl. Writes bigger than
+// one message are split into several, each starting with the same register
+// address byte, and sent in as few ioctls as allowed. That suits devices
+// where the first byte is a control byte that says "more data", like the
+// SSD1306; it does not suit devices that expect a single message with an
+// auto-incrementing register address.
+//
+// Adapters that only do SMBus (no I2C_FUNC_I2C) but have I2C block
+// transfers are driven with those, 32 bytes at a time.
+//
+// Sharing a bus
+//
+// Devices on the same adapter can share one I2cBus, each with a priority
+// (see i2c_bus.h). A device given a slice sends at most that many data
+// bytes per transfer, so others can get on the bus in between; for the
+// SSD1306, 128 (one page) keeps a sensor read from waiting more than about
+// 3 ms at 400 kHz, instead of the 25 ms a whole frame takes.
+//
+//   I2cBus bus("/dev/i2c-1");
+//   I2cDev display(bus, 0x3c, I2cBus::Priority::Low, 128);
+//   I2cDev sensor(bus, 0x44, I2cBus::Priority::High);
 
 
 class I2cDev {
 
     public:
 
-        I2cDev(const char *i2c_dev, uint8_t i2c_adr, int max_msg=32);
+        // max_msg=0 uses the largest message the adapter allows; anything
+        // else caps it (data bytes, not counting the register address)
+        I2cDev(const char *i2c_dev, uint8_t i2c_adr, int max_msg=0);
+
+        // On a shared bus; slice=0 lets transfers be as long as the adapter
+        // allows, anything else caps the data bytes in each one
+        I2cDev(I2cBus& bus, uint8_t i2c_adr,
+               I2cBus::Priority priority=I2cBus::Priority::Normal, int slice=0);
 
         virtual ~I2cDev();
 
+        I2cDev(const I2cDev&) = delete;
+        I2cDev& operator=(const I2cDev&) = delete;
+
+        // false if the device could not be opened
+        bool ok() const { return _ok; }
+
+        // data bytes per message, and messages per ioctl (transfer)
+        int max_msg() const { return _max_msg; }
+        int max_msgs() const { return _max_msgs; }
+
     //protected:
 
         int read(uint8_t reg_adrs, uint8_t *buf, int buf_size=1, int max_tries=1);
@@ -41,12 +88,26 @@ class I2cDev {
 
     private:
 
-        int _i2c_fd;
+        bool _ok;
+
+        // ours if we were given a device name, shared otherwise
+        I2cBus *_bus;
+        bool _own_bus;
+        I2cBus::Priority _priority;
 
         uint8_t _i2c_adr;
 
-        // _buf is used to combine register address (_buf[0]) and user
-        // data (_buf[1...]) so we can write with one i2c transaction
+        int _max_msg;
+        int _max_msgs;
+
+        // _buf is used to combine register address and user data so each
+        // message goes out in one i2c transaction; a write that takes n
+        // messages uses n * (1 + _max_msg) bytes of it, grown as needed
         int _buf_max;
         uint8_t *_buf;
+
+        void limits(int max_msg, int slice);
+
+        // One transfer on the bus: send msgs, returns < 0 on failure
+        int rdwr(i2c_msg *msgs, int nmsgs);
 };
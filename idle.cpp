@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstdint>
+
+#include "idle.h"
+#include "ssd1306_128x64.h"
+
+
+Idle::Idle(Ssd1306_128x64& oled, int dim_ms, int off_ms, uint8_t bright, uint8_t dim) :
+    _oled(oled),
+    _dim_ms(dim_ms),
+    _off_ms(off_ms),
+    _bright(bright),
+    _dim(dim),
+    _dimmed(false),
+    _last_ms(now_ms()),
+    _alert_count(-1),
+    _alert_period_ms(0),
+    _alert_blink(Blink::Invert),
+    _alert_lit(false),
+    _alert_ms(0)
+{
+    _oled.contrast(_bright);
+}
+
+
+long Idle::now_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+// bright and on, sending only what has changed
+void Idle::wake()
+{
+    if (_dimmed) {
+        _oled.contrast(_bright);
+        _dimmed = false;
+    }
+    if (_oled.is_off()) {
+        // what was held back while off goes first, so the panel doesn't
+        // light up showing the old picture
+        _oled.flush_dirty(true);
+        _oled.on();
+    }
+}
+
+
+void Idle::activity()
+{
+    wake();
+    _last_ms = now_ms();
+}
+
+
+void Idle::alert(int period_ms, int count, Blink blink)
+{
+    if (alerting())
+        show_blink(false);
+
+    wake();
+    _alert_count = (count > 0) ? count : 0;
+    _alert_period_ms = (period_ms > 1) ? period_ms : 2;
+    _alert_blink = blink;
+    _alert_ms = now_ms();
+    show_blink(true);
+}
+
+
+void Idle::alert_clear()
+{
+    if (!alerting())
+        return;
+
+    show_blink(false);
+    _alert_count = -1;
+    _last_ms = now_ms();
+}
+
+
+void Idle::show_blink(bool lit)
+{
+    if (_alert_blink == Blink::Invert)
+        _oled.invert(lit);
+    else
+        _oled.entire_on(lit);
+    _alert_lit = lit;
+}
+
+
+void Idle::tick()
+{
+    const long now = now_ms();
+
+    if (alerting()) {
+        const long half = _alert_period_ms / 2;
+        if (now - _alert_ms < half)
+            return;
+        _alert_ms += half;
+        if (now - _alert_ms >= half)
+            _alert_ms = now; // fell behind; don't blink to catch up
+        if (_alert_lit) {
+            show_blink(false);
+            if (_alert_count > 0 && --_alert_count == 0) {
+                _alert_count = -1;
+                _last_ms = now;
+            }
+        } else {
+            show_blink(true);
+        }
+        return;
+    }
+
+    const long idle = now - _last_ms;
+    if (_off_ms > 0 && idle >= _off_ms) {
+        if (!_oled.is_off())
+            _oled.off();
+    } else if (_dim_ms > 0 && idle >= _dim_ms) {
+        if (!_dimmed) {
+            _oled.contrast(_dim);
+            _dimmed = true;
+        }
+    }
+}
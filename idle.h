@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+class Ssd1306_128x64;
+
+
+// Idle handling and alerts
+//
+// Dims the display after a while with no activity, and turns it off after
+// a while longer; activity() brings it back and sends what changed in the
+// meantime. While the display is off, flushes send nothing (see
+// Ssd1306_128x64::off()), so a program can keep drawing as usual without
+// keeping the bus busy for a dark panel.
+//
+// alert() blinks the display with the controller's invert (or entire-on)
+// command: two command bytes per blink instead of redrawing and flushing
+// two frames. An alert wakes the display and keeps it awake until it ends.
+//
+// Nothing happens by itself: call tick() often (from the main loop, say,
+// every 10...50 ms), from the thread that draws.
+//
+//   Idle idle(oled, 30000, 300000);    // dim after 30 s, off after 5 min
+//   ...
+//   if (button_pressed())
+//       idle.activity();
+//   if (temp > limit)
+//       idle.alert(500, 6);            // 6 blinks, 1 s each
+//   idle.tick();
+
+class Idle
+{
+  public:
+
+    enum class Blink {
+        Invert,     // lit pixels go dark and dark ones lit
+        EntireOn,   // every pixel lit
+    };
+
+    // dim_ms, off_ms: idle time before each; 0 never does it
+    Idle(Ssd1306_128x64& oled, int dim_ms, int off_ms=0,
+         uint8_t bright=0x7f, uint8_t dim=0x00);
+
+    // something happened (input, new content): undim, turn on, start timing
+    // from now
+    void activity();
+
+    // blink every period_ms (half of it each way) count times, 0 until
+    // alert_clear()
+    void alert(int period_ms, int count=0, Blink blink=Blink::Invert);
+    void alert_clear();
+    bool alerting() const { return _alert_count >= 0; }
+
+    void tick();
+
+  private:
+
+    Ssd1306_128x64& _oled;
+
+    int _dim_ms;
+    int _off_ms;
+    uint8_t _bright;
+    uint8_t _dim;
+
+    bool _dimmed;
+    long _last_ms;      // last activity (or the end of the last alert)
+
+    // _alert_count < 0: no alert; 0: until cleared; else blinks to go
+    int _alert_count;
+    int _alert_period_ms;
+    Blink _alert_blink;
+    bool _alert_lit;    // in the inverted/lit half of a blink
+    long _alert_ms;     // when the current half started
+
+    void wake();
+    void show_blink(bool lit);
+
+    static long now_ms();
+};
@@ -0,0 +1,270 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mirror.h"
+#include "ssd1306_128x64.h"
+#include "trace.h"
+
+
+static const int frame_bytes = Ssd1306_128x64::cols * (Ssd1306_128x64::rows / 8);
+
+// a client with this much unsent is dropped
+static const size_t queue_max = 64 * 1024;
+
+
+Mirror::Mirror(const char *path) :
+    _ok(false),
+    _listen_fd(-1),
+    _path(nullptr),
+    _prev(new uint8_t[frame_bytes])
+{
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa.sun_path))
+        return;
+    strcpy(sa.sun_path, path);
+
+    // an old socket is replaced, but nothing else is (a mistyped path must
+    // not delete a file)
+    struct stat st;
+    const bool exists = lstat(path, &st) == 0;
+    if (exists && !S_ISSOCK(st.st_mode))
+        return;
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen_fd < 0)
+        return;
+
+    if (exists)
+        unlink(path);
+    if (bind(_listen_fd, (sockaddr *)&sa, sizeof(sa)) < 0 || listen(_listen_fd, 4) < 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        return;
+    }
+
+    _path = strdup(path);
+    _ok = true;
+}
+
+
+Mirror::Mirror(int fd) :
+    _ok(false),
+    _listen_fd(-1),
+    _path(nullptr),
+    _prev(new uint8_t[frame_bytes])
+{
+    if (fd < 0)
+        return;
+
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return;
+
+    int type;
+    socklen_t len = sizeof(type);
+    const bool socket = getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0;
+
+    _clients.push_back({ fd, false, socket, false, {} });
+    _ok = true;
+}
+
+
+Mirror::~Mirror()
+{
+    while (!_clients.empty())
+        drop(_clients.size() - 1);
+
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+        unlink(_path);
+    }
+
+    free(_path);
+    delete[] _prev;
+}
+
+
+void Mirror::frame(const uint8_t *image)
+{
+    OLED_TRACE_SCOPE(t, "mirror");
+
+    if (_listen_fd >= 0)
+        accept_clients();
+
+    if (_clients.empty())
+        return;
+
+    // new clients get a keyframe, the rest a delta if anything changed
+    bool keyed = false;
+    for (const Client& c : _clients) {
+        if (c.keyed)
+            keyed = true;
+    }
+    const bool changed = keyed && delta(image);
+
+    bool key_built = false;
+    for (size_t i = 0; i < _clients.size(); ) {
+        Client& c = _clients[i];
+        bool sent = true;
+        if (!c.keyed) {
+            if (!key_built) {
+                keyframe(image);
+                key_built = true;
+            }
+            sent = send(c, _key.data(), _key.size());
+            c.keyed = true;
+        } else if (changed) {
+            sent = send(c, _delta.data(), _delta.size());
+        } else if (!c.queue.empty()) {
+            sent = send(c, nullptr, 0); // catching up
+        }
+        if (sent)
+            i++;
+        else
+            drop(i);
+    }
+
+    memcpy(_prev, image, frame_bytes);
+}
+
+
+void Mirror::accept_clients()
+{
+    int fd;
+    while ((fd = accept4(_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        _clients.push_back({ fd, true, true, false, {} });
+}
+
+
+static void header(std::vector<uint8_t>& msg, char type)
+{
+    msg.clear();
+    msg.push_back(uint8_t(type));
+    msg.push_back(0);   // length, filled in at the end
+    msg.push_back(0);
+}
+
+
+static void length(std::vector<uint8_t>& msg)
+{
+    const size_t n = msg.size() - 3;
+    msg[1] = uint8_t(n);
+    msg[2] = uint8_t(n >> 8);
+}
+
+
+void Mirror::keyframe(const uint8_t *image)
+{
+    header(_key, 'K');
+    _key.push_back(uint8_t(Ssd1306_128x64::cols));
+    _key.push_back(uint8_t(Ssd1306_128x64::rows / 8));
+    _key.insert(_key.end(), image, image + frame_bytes);
+    length(_key);
+}
+
+
+// Into _delta; false if image is the same as _prev
+bool Mirror::delta(const uint8_t *image)
+{
+    const uint8_t *prev = _prev;
+    const int n = frame_bytes;
+
+    header(_delta, 'D');
+
+    int i = 0;
+    while (i < n) {
+        // unchanged bytes, a word at a time while whole words match
+        int j = i;
+        while (j + 8 <= n) {
+            uint64_t a, b;
+            memcpy(&a, image + j, 8);
+            memcpy(&b, prev + j, 8);
+            if (a != b)
+                break;
+            j += 8;
+        }
+        while (j < n && image[j] == prev[j])
+            j++;
+        if (j == n)
+            break; // the rest is unchanged; no need to say so
+
+        for (int skip = j - i; skip > 0; ) {
+            const int k = (skip > 128) ? 128 : skip;
+            _delta.push_back(uint8_t(0x80 | (k - 1)));
+            skip -= k;
+        }
+
+        // changed bytes; one unchanged byte between changes costs less
+        // inside the run than it would to end the run and skip it
+        i = j;
+        while (j < n && j - i < 128) {
+            if (image[j] != prev[j])
+                j++;
+            else if (j + 1 < n && j + 1 - i < 128 && image[j + 1] != prev[j + 1])
+                j += 2;
+            else
+                break;
+        }
+        _delta.push_back(uint8_t(j - i - 1));
+        for (int k = i; k < j; k++)
+            _delta.push_back(image[k] ^ prev[k]);
+        i = j;
+    }
+
+    if (_delta.size() == 3)
+        return false;
+
+    length(_delta);
+    return true;
+}
+
+
+// false if the client should be dropped
+bool Mirror::send(Client& c, const uint8_t *buf, int len)
+{
+    auto put = [&c](const uint8_t *p, size_t n) -> ssize_t {
+        ssize_t r = c.socket ? ::send(c.fd, p, n, MSG_NOSIGNAL | MSG_DONTWAIT)
+                             : ::write(c.fd, p, n);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            r = 0;
+        return r;
+    };
+
+    // what's left from before goes first
+    if (!c.queue.empty()) {
+        const ssize_t r = put(c.queue.data(), c.queue.size());
+        if (r < 0)
+            return false;
+        c.queue.erase(c.queue.begin(), c.queue.begin() + r);
+    }
+
+    int done = 0;
+    if (c.queue.empty()) {
+        const ssize_t r = put(buf, len);
+        if (r < 0)
+            return false;
+        done = int(r);
+    }
+    c.queue.insert(c.queue.end(), buf + done, buf + len);
+
+    return c.queue.size() <= queue_max;
+}
+
+
+void Mirror::drop(size_t i)
+{
+    if (_clients[i].own)
+        close(_clients[i].fd);
+    _clients.erase(_clients.begin() + i);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Display mirroring
+//
+// A Mirror attached to a display (Ssd1306_128x64::mirror()) gets every frame
+// that flush() or flush_dirty() sends, and streams it to whoever is
+// watching: clients of a Unix domain socket, or one fd such as a pipe.
+// oled_view decodes the stream to PBM.
+//
+// Each message is a type byte, a 16-bit little-endian payload length, and
+// the payload:
+//
+//   'K' keyframe: cols, pages, then the image, page-major as in the display
+//   'D' delta: the image XOR the previous one, run-length coded; a code
+//       byte 0x80 | (n - 1) skips n unchanged bytes, a code byte n - 1 is
+//       followed by n bytes to XOR in (n is 1...128). Bytes past the end of
+//       the codes are unchanged.
+//
+// A client gets a keyframe first, then deltas. Frames that change nothing
+// aren't sent at all.
+//
+// Nothing here blocks: a client that falls behind has its messages queued,
+// and is dropped once that queue passes 64 KB (a socket client can simply
+// connect again). A reader that goes away is dropped too; writing to a pipe
+// whose reader has gone raises SIGPIPE, so ignore that signal when
+// mirroring to a pipe.
+
+class Mirror
+{
+  public:
+
+    // listen on a Unix stream socket at path (an old socket there is
+    // replaced; anything else there is left alone, and ok() is false)
+    explicit Mirror(const char *path);
+
+    // write to fd, which is made non-blocking and is not closed
+    explicit Mirror(int fd);
+
+    ~Mirror();
+
+    Mirror(const Mirror&) = delete;
+    Mirror& operator=(const Mirror&) = delete;
+
+    // false if the socket could not be set up
+    bool ok() const { return _ok; }
+
+    int clients() const { return int(_clients.size()); }
+
+    // image is Ssd1306_128x64::pages runs of Ssd1306_128x64::cols bytes
+    void frame(const uint8_t *image);
+
+  private:
+
+    struct Client {
+        int fd;
+        bool own;               // close it when dropped
+        bool socket;            // send() with MSG_NOSIGNAL; else write()
+        bool keyed;             // has had a keyframe
+        std::vector<uint8_t> queue;
+    };
+
+    bool _ok;
+    int _listen_fd;
+    char *_path;
+
+    std::vector<Client> _clients;
+
+    // the last frame sent, for deltas
+    uint8_t *_prev;
+
+    // messages being sent
+    std::vector<uint8_t> _key;
+    std::vector<uint8_t> _delta;
+
+    void accept_clients();
+    void keyframe(const uint8_t *image);
+    bool delta(const uint8_t *image);
+    bool send(Client& c, const uint8_t *buf, int len);
+    void drop(size_t i);
+};
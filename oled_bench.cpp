@@ -0,0 +1,375 @@
+// Benchmark drawing primitives and flush() without hardware
+//
+// The display's I2cDev is on I2cSim, a simulated bus that accepts every
+// transfer, counts ioctls and bytes, and works out how long they would hold
+// a real bus.
+// Results go to stdout as JSON so runs can be compared across versions.
+//
+// oled_bench [-m min_ms] [-k bus_khz] [-c max_msg] [-n max_msgs]
+//
+// -m is the minimum time spent on each measurement (default 100 ms)
+// -k is the simulated bus clock (default 400 kHz, see i2c_dev.h)
+// -c and -n are the simulated adapter's limits: data bytes per message and
+//    messages per ioctl (default 8191 and 42, what i2c-dev allows)
+//
+// The "shared_bus" section runs the display flushing continuously, at Low
+// priority, on a simulated bus that takes real time, while a High priority
+// sensor is read every few ms; it reports how long those reads wait.
+
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/i2c.h>
+
+#include "display_list.h"
+#include "i2c_bus.h"
+#include "i2c_dev.h"
+#include "mirror.h"
+#include "readout.h"
+#include "ssd1306_128x64.h"
+#include "surface.h"
+
+#include "font_5x7.h"
+
+
+// A bus that accepts every transfer, counts ioctls and bytes, and works out
+// how long they would hold a real bus. With real_time, it also holds the
+// bus for that long.
+class I2cSim : public I2cBus {
+
+    public:
+
+        I2cSim(int max_msg, int max_msgs, int bus_khz, bool real_time=false) :
+            I2cBus(max_msg, max_msgs),
+            _bus_khz(bus_khz),
+            _real_time(real_time)
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            ioctls = 0;
+            msgs = 0;
+            bytes = 0;
+            bus_us = 0;
+        }
+
+        long ioctls;
+        long msgs;
+        long bytes;
+        double bus_us;
+
+    protected:
+
+        // Each message is a start, the address byte, the data bytes, and a
+        // stop; each byte is 9 clocks with the ack.
+        int xfer(i2c_msg *m, int nmsgs) override
+        {
+            double us = 0;
+            for (int i = 0; i < nmsgs; i++)
+                us += (1 + 9 * (1 + m[i].len) + 1) * 1000.0 / _bus_khz;
+
+            ioctls++;
+            msgs += nmsgs;
+            for (int i = 0; i < nmsgs; i++)
+                bytes += m[i].len;
+            bus_us += us;
+
+            if (_real_time)
+                std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(us));
+            return nmsgs;
+        }
+
+    private:
+
+        int _bus_khz;
+        bool _real_time;
+};
+
+
+static double min_ms = 100;
+
+
+// Run op in batches until min_ms has gone by; returns ns per call
+static double time_op(const std::function<void()>& op)
+{
+    using clock = std::chrono::steady_clock;
+
+    long n = 0;
+    long batch = 1;
+    const clock::time_point start = clock::now();
+    double elapsed_ns;
+    while (true) {
+        for (long i = 0; i < batch; i++)
+            op();
+        n += batch;
+        elapsed_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        if (elapsed_ns >= min_ms * 1e6)
+            break;
+        if (batch < (1 << 20))
+            batch *= 2;
+    }
+
+    return elapsed_ns / n;
+}
+
+
+static bool first_result;
+
+
+static void primitive(const char *name, const std::function<void()>& op)
+{
+    const double ns = time_op(op);
+    printf("%s\n    { \"name\": \"%s\", \"ns_per_op\": %.1f }",
+           first_result ? "" : ",", name, ns);
+    first_result = false;
+}
+
+
+static void bus_op(const char *name, I2cSim& sim, const std::function<void()>& op)
+{
+    // one call for the bus numbers...
+    sim.reset();
+    op();
+    const long ioctls = sim.ioctls;
+    const long msgs = sim.msgs;
+    const long bytes = sim.bytes;
+    const double bus_us = sim.bus_us;
+
+    // ...and many for the cpu time
+    const double ns = time_op(op);
+
+    printf("%s\n    { \"name\": \"%s\", \"ns_per_op\": %.1f, \"ioctls\": %ld, "
+           "\"msgs\": %ld, \"bytes\": %ld, \"bus_us\": %.1f }",
+           first_result ? "" : ",", name, ns, ioctls, msgs, bytes, bus_us);
+    first_result = false;
+}
+
+
+// A display flushing back to back while a sensor is read every 5 ms;
+// prints the reads' worst and average time, start to finish
+static void shared_bus(const char *name, I2cSim& bus, int slice)
+{
+    using clock = std::chrono::steady_clock;
+
+    I2cDev display_dev(bus, 0x3c, I2cBus::Priority::Low, slice);
+    I2cDev sensor_dev(bus, 0x44, I2cBus::Priority::High);
+    Ssd1306_128x64 display(display_dev, true);
+
+    std::atomic<bool> stop(false);
+    long flushes = 0;
+    std::thread flusher([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            display.flush();
+            flushes++;
+        }
+    });
+
+    // includes the read's own time on the bus, about 0.1 ms
+    uint8_t buf[2];
+    const int reads = int(min_ms / 5) + 10;
+    double worst_us = 0;
+    double total_us = 0;
+    for (int i = 0; i < reads; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        const clock::time_point start = clock::now();
+        sensor_dev.read(0x00, buf, sizeof(buf));
+        const double us = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        if (us > worst_us)
+            worst_us = us;
+        total_us += us;
+    }
+
+    stop.store(true, std::memory_order_relaxed);
+    flusher.join();
+
+    printf("%s\n    { \"name\": \"%s\", \"slice\": %d, \"flushes\": %ld, "
+           "\"reads\": %d, \"read_worst_us\": %.0f, \"read_avg_us\": %.0f }",
+           first_result ? "" : ",", name, slice, flushes, reads, worst_us,
+           total_us / reads);
+    first_result = false;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int bus_khz = 400;
+    int max_msg = 8191;
+    int max_msgs = 42;
+
+    const char *optstr = "m:k:c:n:";
+    int opt;
+    while ((opt = getopt(argc, argv, optstr)) != -1) {
+        switch (opt) {
+            case 'm':
+                min_ms = atof(optarg);
+                break;
+            case 'k':
+                bus_khz = atoi(optarg);
+                break;
+            case 'c':
+                max_msg = atoi(optarg);
+                break;
+            case 'n':
+                max_msgs = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-m min_ms] [-k bus_khz] [-c max_msg] [-n max_msgs]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    if (min_ms <= 0 || bus_khz <= 0 || max_msg <= 0 || max_msgs <= 0) {
+        fprintf(stderr, "%s: -m, -k, -c and -n must be positive\n", argv[0]);
+        return 1;
+    }
+
+    I2cSim sim(max_msg, max_msgs, bus_khz);
+    I2cDev dev(sim, 0x3c);
+    Ssd1306_128x64 oled(dev);
+
+    Surface1 surface1(oled.cols, oled.rows);
+    Surface8 surface8(oled.cols, oled.rows);
+    for (int y = 0; y < oled.rows; y++) {
+        for (int x = 0; x < oled.cols; x++) {
+            if ((x ^ y) & 4) {
+                surface1.set(x, y);
+                surface8.set(x, y);
+            }
+        }
+    }
+
+    // a typical screen: title, a big number, a couple of labels, a frame
+    auto redraw = [&]() {
+        oled.clear();
+        oled.puts(-2, 0, "Status", font_5x7);
+        oled.hline(0, oled.cols - 1, 9);
+        oled.puts2(-2, 2, "123.4", font_5x7);
+        oled.puts(0, 5, "temp   21.5 C", font_5x7);
+        oled.puts(0, 6, "humid  48 %", font_5x7);
+        oled.box(0, 0, oled.cols - 1, oled.rows - 1);
+    };
+
+    // the same screen, recorded
+    DisplayList redraw_list;
+    redraw_list.clear();
+    redraw_list.puts(-2, 0, "Status", font_5x7);
+    redraw_list.hline(0, oled.cols - 1, 9);
+    redraw_list.puts2(-2, 2, "123.4", font_5x7);
+    redraw_list.puts(0, 5, "temp   21.5 C", font_5x7);
+    redraw_list.puts(0, 6, "humid  48 %", font_5x7);
+    redraw_list.box(0, 0, oled.cols - 1, oled.rows - 1);
+
+    int i = 0;
+
+    printf("{\n  \"version\": \"%s\",\n", OLED_VERSION);
+    printf("  \"build_type\": \"%s\",\n", OLED_BUILD_TYPE);
+    printf("  \"transpose\": \"%s\",\n", transpose_name(transpose_selected()));
+    printf("  \"bus_khz\": %d,\n", bus_khz);
+    printf("  \"max_msg\": %d,\n", sim.max_msg());
+    printf("  \"max_msgs\": %d,\n", sim.max_msgs());
+
+    printf("  \"primitives\": [");
+    first_result = true;
+    primitive("set", [&]() { oled.set(i & 127, i & 63); i++; });
+    primitive("putc", [&]() { oled.putc(i % 21, i & 7, 'A' + (i & 15), font_5x7); i++; });
+    primitive("putc2", [&]() { oled.putc2(i % 20, i % 7, 'A' + (i & 15), font_5x7); i++; });
+    primitive("putc_at", [&]() { oled.putc_at(i % 123, i % 57, 'A' + (i & 15), font_5x7); i++; });
+    primitive("puts2", [&]() { oled.puts2(0, i % 7, "0123456789", font_5x7); i++; });
+    primitive("hline", [&]() { oled.hline(0, oled.cols - 1, i & 63); i++; });
+    primitive("vline", [&]() { oled.vline(i & 127, 0, oled.rows - 1); i++; });
+    primitive("fill", [&]() { oled.fill(10, 10, 117, 53, i & 1); i++; });
+    primitive("box", [&]() { oled.box(i & 15, i & 15, 127 - (i & 15), 63 - (i & 15)); i++; });
+    primitive("clear", [&]() { oled.clear(); });
+    primitive("blit_1bpp", [&]() { oled.blit(surface1); });
+    primitive("blit_8bpp", [&]() { oled.blit(surface8); });
+    primitive("redraw", redraw);
+    primitive("redraw_replay", [&]() { redraw_list.replay(oled); });
+    Readout readout(0, 16, 32, 5);
+    long count = 0;
+    primitive("readout_tick", [&]() { readout.show(oled, count++ % 100000); });
+    printf("\n  ],\n");
+
+    redraw();
+
+    printf("  \"flush\": [");
+    first_result = true;
+    bus_op("flush", sim, [&]() { oled.flush(); });
+    // the same with a mirror watching, and a pixel changed each time so
+    // there is always a delta to encode and send
+    {
+        const int null_fd = open("/dev/null", O_WRONLY);
+        Mirror mirror(null_fd);
+        oled.mirror(&mirror);
+        bus_op("flush_mirrored", sim, [&]() {
+            oled.set(i & 127, 0, i & 1);
+            i++;
+            oled.flush();
+        });
+        oled.mirror(nullptr);
+        close(null_fd);
+    }
+    // a counter on an otherwise unchanged screen: usually one digit
+    bus_op("flush_dirty_tick", sim, [&]() {
+        readout.show(oled, count++ % 100000);
+        oled.flush_dirty();
+    });
+    printf("\n  ],\n");
+
+    // one blink of an alert: the screen drawn inverted and flushed, then
+    // drawn normally and flushed (a lit screen stands in for the inverted
+    // one; the bus doesn't care), against the controller's invert command
+    // on and off
+    printf("  \"blink\": [");
+    first_result = true;
+    bus_op("redraw", sim, [&]() {
+        oled.fill(0, 0, oled.cols - 1, oled.rows - 1);
+        oled.flush();
+        redraw();
+        oled.flush();
+    });
+    bus_op("invert", sim, [&]() {
+        oled.invert(true);
+        oled.invert(false);
+    });
+    printf("\n  ],\n");
+
+    // from nothing to the first real frame on the panel
+    printf("  \"startup\": [");
+    first_result = true;
+    bus_op("cold", sim, [&]() {
+        Ssd1306_128x64 o(dev);
+        o.clear();
+        o.flush();
+        o.on();
+        redraw_list.replay(o);
+        o.flush();
+    });
+    bus_op("warm", sim, [&]() {
+        Ssd1306_128x64 o(dev, true);
+        o.on();
+        redraw_list.replay(o);
+        o.flush();
+    });
+    printf("\n  ],\n");
+
+    // a whole frame per transfer, then one page per transfer
+    I2cSim bus(max_msg, max_msgs, bus_khz, true);
+    printf("  \"shared_bus\": [");
+    first_result = true;
+    shared_bus("frame", bus, 0);
+    shared_bus("page", bus, Ssd1306_128x64::cols);
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Errors that are the caller's bug (bad sizes and the like) throw
+// std::invalid_argument. Built with OLED_EXCEPTIONS=OFF (-fno-exceptions),
+// they print the message and abort instead.
+//
+// Drawing never gets here; coordinates off the display are clipped.
+
+#if defined(OLED_NO_EXCEPTIONS)
+
+#include <cstdio>
+#include <cstdlib>
+
+#define OLED_INVALID(msg) \
+    do { fprintf(stderr, "%s\n", (msg)); abort(); } while (0)
+
+#else
+
+#include <stdexcept>
+
+#define OLED_INVALID(msg) throw std::invalid_argument(msg)
+
+#endif
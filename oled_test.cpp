@@ -4,15 +4,25 @@
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <memory>
+#include <thread>
 
+#include "display_list.h"
 #include "i2c_dev.h"
+#include "idle.h"
+#include "mirror.h"
+#include "readout.h"
+#include "renderer.h"
 #include "ssd1306_128x64.h"
 
 #include "font_5x7.h"
+#include "font_file.h"
+#include "surface.h"
+#include "trace.h"
 
 const uint8_t i2c_adr = 0x3c;
-I2cDev i2c_dev("/dev/i2c-1", i2c_adr, 256);
-Ssd1306_128x64 oled(i2c_dev);
+I2cDev i2c_dev("/dev/i2c-1", i2c_adr);
+std::unique_ptr<Ssd1306_128x64> oled; // created in main, once we know if it's warm
 
 static void boxes();
 static void stripes();
@@ -23,30 +33,69 @@ static void chars_at();
 static void fancy();
 static void fancy2();
 static void fills();
+static void surface();
+static void scroll();
+static void font_file(const char *path);
+static void threads();
+static void readout();
+static void idle();
 
 
 int main(int argc, char *argv[])
 {
     int test_num = -1;
-    const char *optstr = "t:";
+    const char *font_path = nullptr;
+    bool warm = false;
+    const char *trace_path = nullptr;
+    const char *mirror_path = nullptr;
+    const char *optstr = "t:f:wT:m:";
     int opt;
     while ((opt = getopt(argc, argv, optstr)) != -1) {
         switch (opt) {
             case 't':
                 test_num = atoi(optarg);
                 break;
+            case 'f':
+                font_path = optarg;
+                break;
+            case 'w':
+                // controller already set up; keep showing what's there
+                // until the first test pattern replaces it
+                warm = true;
+                break;
+            case 'm':
+                // watch with: oled_view <path>
+                mirror_path = optarg;
+                break;
+            case 'T':
+                // needs OLED_TRACE=ON
+                trace_path = optarg;
+                break;
             default:
                 break;
         }
     }
 
-    oled.clear();
-    oled.flush();
-    oled.on();
+    oled.reset(new Ssd1306_128x64(i2c_dev, warm));
+
+    std::unique_ptr<Mirror> mirror;
+    if (mirror_path != nullptr) {
+        mirror.reset(new Mirror(mirror_path));
+        if (mirror->ok())
+            oled->mirror(mirror.get());
+        else
+            fprintf(stderr, "can't mirror to %s\n", mirror_path);
+    }
+
+    if (!warm) {
+        oled->clear();
+        oled->flush();
+    }
+    oled->on();
 
     switch (test_num) {
         case 0:
-            oled.on();
+            oled->on();
             break;
         case 1:
             boxes();
@@ -75,35 +124,65 @@ int main(int argc, char *argv[])
         case 9:
             fills();
             break;
+        case 10:
+            surface();
+            break;
+        case 11:
+            scroll();
+            break;
+        case 12:
+            // -f font.olf (from bdf2olf)
+            font_file(font_path);
+            break;
+        case 13:
+            threads();
+            break;
+        case 14:
+            readout();
+            break;
+        case 15:
+            idle();
+            break;
         default:
             boxes();
             sleep(1);
-            oled.clear();
+            oled->clear();
             stripes();
             sleep(1);
-            oled.clear();
+            oled->clear();
             dots();
             sleep(1);
-            oled.clear();
+            oled->clear();
             chars();
             sleep(1);
-            oled.clear();
+            oled->clear();
             chars2();
             sleep(1);
-            oled.clear();
+            oled->clear();
             chars_at();
             sleep(1);
-            oled.clear();
+            oled->clear();
             fancy();
             sleep(1);
-            oled.clear();
+            oled->clear();
             fancy2();
             sleep(1);
-            oled.clear();
+            oled->clear();
             fills();
+            sleep(1);
+            oled->clear();
+            surface();
+            sleep(1);
+            oled->clear();
+            scroll();
             break;
     }
 
+    oled.reset(); // before the mirror it sends to
+
+    if (trace_path != nullptr && !trace_write(trace_path))
+        fprintf(stderr, "can't write trace %s (built with OLED_TRACE?)\n", trace_path);
+
     return 0;
 
 } // main
@@ -112,99 +191,225 @@ int main(int argc, char *argv[])
 static void boxes()
 {
     for (int i = 0; i < 10; i += 2)
-        oled.box(i, i, oled.cols - 1 - i, oled.rows - 1 - i);
-    oled.flush();
+        oled->box(i, i, oled->cols - 1 - i, oled->rows - 1 - i);
+    oled->flush();
 }
 
 
 static void stripes()
 {
-    for (int x = 0; x < oled.cols; x += 4) {
-        for (int y = 0; y < oled.rows; y++) {
-            if (x + y < oled.cols)
-                oled.set(x + y, y);
+    for (int x = 0; x < oled->cols; x += 4) {
+        for (int y = 0; y < oled->rows; y++) {
+            if (x + y < oled->cols)
+                oled->set(x + y, y);
             else
-                oled.set(x + y - oled.cols, y);
+                oled->set(x + y - oled->cols, y);
         }
     }
-    oled.flush();
+    oled->flush();
 }
 
 
 static void dots()
 {
-    oled.set(0, 0);
-    oled.set(0, oled.rows - 1);
-    oled.set(oled.cols - 1, 0);
-    oled.set(oled.cols - 1, oled.rows - 1);
-    oled.flush();
+    oled->set(0, 0);
+    oled->set(0, oled->rows - 1);
+    oled->set(oled->cols - 1, 0);
+    oled->set(oled->cols - 1, oled->rows - 1);
+    oled->flush();
 }
 
 
 static void chars()
 {
-    oled.puts(0, 0, " !\"#$%&'()*+,-./", font_5x7);
-    oled.puts(0, 1, "0123456789:;<=>?", font_5x7);
-    oled.puts(0, 2, "@ABCDEFGHIJKLMNO", font_5x7);
-    oled.puts(0, 3, "PQRSTUVWXYZ[\\]^_", font_5x7);
-    oled.flush();
+    oled->puts(0, 0, " !\"#$%&'()*+,-./", font_5x7);
+    oled->puts(0, 1, "0123456789:;<=>?", font_5x7);
+    oled->puts(0, 2, "@ABCDEFGHIJKLMNO", font_5x7);
+    oled->puts(0, 3, "PQRSTUVWXYZ[\\]^_", font_5x7);
+    oled->flush();
 }
 
 
 static void chars2()
 {
-    oled.puts2(0, 0, "0123456789", font_5x7);
-    oled.puts2(0, 2, "ABCDEFGHIJ", font_5x7);
-    oled.puts2(0, 4, "KLMNOPQRST", font_5x7);
-    oled.puts2(0, 6, "!@#$%^&*()", font_5x7);
-    oled.flush();
+    oled->puts2(0, 0, "0123456789", font_5x7);
+    oled->puts2(0, 2, "ABCDEFGHIJ", font_5x7);
+    oled->puts2(0, 4, "KLMNOPQRST", font_5x7);
+    oled->puts2(0, 6, "!@#$%^&*()", font_5x7);
+    oled->flush();
 }
 
 
 static void chars_at()
 {
     // fill white
-    for (int x = 0; x < oled.cols; x++)
-        for (int y = 0; y < oled.rows; y++)
-            oled.set(x, y);
+    for (int x = 0; x < oled->cols; x++)
+        for (int y = 0; y < oled->rows; y++)
+            oled->set(x, y);
 
     char c = '0';
     for (int i = 0; i < 20; i++)
-        oled.putc_at(i * 6, i, c, font_5x7);
+        oled->putc_at(i * 6, i, c, font_5x7);
 
-    oled.flush();
+    oled->flush();
 }
 
 
 static void fancy()
 {
-    oled.box(40, 8, 87, 55);
-    oled.putc_at(62, 57, '0', font_5x7); // bottom
-    oled.putc_at(89, 29, '1', font_5x7); // right
-    oled.putc_at(62,  0, '2', font_5x7); // top
-    oled.putc_at(34, 29, '3', font_5x7); // left
-    oled.flush();
+    oled->box(40, 8, 87, 55);
+    oled->putc_at(62, 57, '0', font_5x7); // bottom
+    oled->putc_at(89, 29, '1', font_5x7); // right
+    oled->putc_at(62,  0, '2', font_5x7); // top
+    oled->putc_at(34, 29, '3', font_5x7); // left
+    oled->flush();
 }
 
 
 static void fancy2()
 {
     //       x1  y1  x2  y2
-    oled.box(48, 16, 81, 45);
+    oled->box(48, 16, 81, 45);
     //        col row char
-    oled.putc2(10, 6, '4', font_5x7); // bottom
-    oled.putc2(14, 3, '5', font_5x7); // right
-    oled.putc2(10, 0, '6', font_5x7); // top
-    oled.putc2( 6, 3, '7', font_5x7); // left
-    oled.flush();
+    oled->putc2(10, 6, '4', font_5x7); // bottom
+    oled->putc2(14, 3, '5', font_5x7); // right
+    oled->putc2(10, 0, '6', font_5x7); // top
+    oled->putc2( 6, 3, '7', font_5x7); // left
+    oled->flush();
 }
 
 
 static void fills()
 {
     //        x1  y1   x2  y2
-    oled.fill( 0,  0,   0,  0); // dot in upper left corner
-    oled.fill( 2,  2,   3,  3); // 2x2
-    oled.fill( 5,  0, 127, 63); // 2x2
-    oled.flush();
+    oled->fill( 0,  0,   0,  0); // dot in upper left corner
+    oled->fill( 2,  2,   3,  3); // 2x2
+    oled->fill( 5,  0, 127, 63); // 2x2
+    oled->flush();
+}
+
+
+static void surface()
+{
+    // circle drawn row-major, then converted to pages
+    Surface1 s(oled->cols, oled->rows);
+    const int cx = oled->cols / 2;
+    const int cy = oled->rows / 2;
+    const int r = 28;
+    for (int y = 0; y < oled->rows; y++) {
+        for (int x = 0; x < oled->cols; x++) {
+            const int d = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            if (d <= r * r && d >= (r - 3) * (r - 3))
+                s.set(x, y);
+        }
+    }
+    oled->blit(s);
+    oled->flush();
+}
+
+
+static void scroll()
+{
+    // text scrolls through a window in the middle of the display, clipped
+    // at its edges
+    const char *s = "Scrolling through a viewport";
+    const int w = strlen(s) * 6;
+    oled->box(19, 19, 108, 44);
+    oled->viewport(20, 20, 88, 24);
+    for (int x = 88; x > -w; x--) {
+        oled->fill(0, 0, 87, 23, 0);
+        oled->puts_at(x, 4, s, font_5x7);
+        oled->puts_at(x + 10, 13, s, font_5x7);
+        oled->flush();
+    }
+    oled->reset_viewport();
+}
+
+
+static void font_file(const char *path)
+{
+    if (path == nullptr) {
+        fprintf(stderr, "font_file: no font (-f)\n");
+        return;
+    }
+
+    FontFile font(path);
+    if (!font.ok()) {
+        fprintf(stderr, "font_file: can't load %s\n", path);
+        return;
+    }
+
+    int y = 0;
+    oled->puts_at(0, y, "Temp 21.5\u00b0C", font);
+    y += font.height();
+    oled->puts_at(0, y, "I 350\u00b5A \u2191\u2193\u2190\u2192", font);
+    y += font.height();
+    oled->puts_at(0, y, "\u0394t \u03a9 \u00e9\u00e8\u00fc", font);
+    oled->flush();
+}
+
+
+static void threads()
+{
+    Renderer renderer(*oled);
+
+    // static part of the screen, recorded once
+    auto frame = std::make_shared<DisplayList>();
+    frame->clear();
+    frame->box(0, 0, oled->cols - 1, oled->rows - 1);
+    frame->puts(-2, 1, "threads", font_5x7);
+    renderer.submit(frame);
+
+    // two threads counting at different rates, each in its own row
+    auto counter = [&renderer](int row, int ms) {
+        for (int n = 0; n <= 50; n++) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%3d", n);
+            auto dl = std::make_shared<DisplayList>();
+            dl->fill(1, row * 8, 126, row * 8 + 7, 0);
+            dl->puts(-2, row, buf, font_5x7);
+            renderer.submit(dl);
+            usleep(ms * 1000);
+        }
+    };
+    std::thread t1(counter, 3, 20);
+    std::thread t2(counter, 5, 50);
+    t1.join();
+    t2.join();
+}
+
+
+static void readout()
+{
+    // a counter in big digits, and a scaled one under it; each tick redraws
+    // only the digits that changed, and only those go to the display
+    Readout big(0, 0, 40, 4);
+    Readout small(0, 48, 16, 8, Readout::Style::Scaled);
+    for (int n = 0; n <= 250; n++) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d.%d", n / 10, n % 10);
+        big.show(*oled, buf);
+        small.show(*oled, long(n) * 37);
+        oled->flush_dirty();
+        usleep(20 * 1000);
+    }
+}
+
+
+static void idle()
+{
+    // blink, then dim after 2 s and go off after 4 s; the counter keeps
+    // drawing and flushing throughout, and the bus goes quiet once it's off
+    Idle idle(*oled, 2000, 4000);
+    Readout count(0, 16, 32, 5);
+
+    idle.alert(400, 5);
+    for (int n = 0; n < 400; n++) {
+        if (n == 300)
+            idle.activity(); // on again, showing the current count
+        count.show(*oled, long(n));
+        oled->flush_dirty();
+        idle.tick();
+        usleep(20 * 1000);
+    }
 }
@@ -0,0 +1,185 @@
+// Decode a display mirror stream (see mirror.h) to PBM
+//
+// oled_view [-o out.pbm] [-n frames] [socket]
+//
+// Reads from the Unix socket a program is mirroring to, or from stdin if no
+// socket is given (e.g. a pipe). Each frame rewrites out.pbm (default
+// oled.pbm) in one go, so an image viewer that reloads it never sees half a
+// frame. If out contains a printf format for a number, e.g. frame%04d.pbm,
+// each frame gets a file of its own instead.
+//
+// -n stops after that many frames; otherwise it runs until the stream ends.
+
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-o out.pbm] [-n frames] [socket]\n", prog);
+    exit(1);
+}
+
+
+// false at end of stream
+static bool read_all(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        const ssize_t r = read(fd, buf, len);
+        if (r <= 0)
+            return false;
+        buf += r;
+        len -= r;
+    }
+    return true;
+}
+
+
+// Page-major image to PBM (P4): rows top to bottom, 8 pixels a byte, MSB
+// on the left
+static bool write_pbm(const char *name, const std::vector<uint8_t>& image,
+                      int cols, int pages)
+{
+    const std::string tmp = std::string(name) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        perror(tmp.c_str());
+        return false;
+    }
+
+    const int rows = pages * 8;
+    const int stride = (cols + 7) / 8;
+    fprintf(f, "P4\n%d %d\n", cols, rows);
+    std::vector<uint8_t> row(stride);
+    for (int y = 0; y < rows; y++) {
+        std::fill(row.begin(), row.end(), 0);
+        const uint8_t *page = &image[(y / 8) * cols];
+        for (int x = 0; x < cols; x++)
+            if (page[x] & (1 << (y % 8)))
+                row[x / 8] |= 0x80 >> (x % 8);
+        fwrite(row.data(), 1, stride, f);
+    }
+
+    if (fclose(f) != 0 || rename(tmp.c_str(), name) != 0) {
+        perror(name);
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *out = "oled.pbm";
+    long max_frames = 0;
+
+    const char *optstr = "o:n:";
+    int opt;
+    while ((opt = getopt(argc, argv, optstr)) != -1) {
+        switch (opt) {
+            case 'o':
+                out = optarg;
+                break;
+            case 'n':
+                max_frames = atol(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (argc - optind > 1)
+        usage(argv[0]);
+
+    int fd = 0;
+    if (argc - optind == 1) {
+        const char *path = argv[optind];
+        sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(sa.sun_path)) {
+            fprintf(stderr, "%s: path too long\n", path);
+            return 1;
+        }
+        strcpy(sa.sun_path, path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (sockaddr *)&sa, sizeof(sa)) < 0) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    const bool numbered = strchr(out, '%') != nullptr;
+
+    int cols = 0;
+    int pages = 0;
+    std::vector<uint8_t> image;
+    std::vector<uint8_t> payload;
+    long frames = 0;
+
+    while (max_frames == 0 || frames < max_frames) {
+        uint8_t hdr[3];
+        if (!read_all(fd, hdr, sizeof(hdr)))
+            break;
+        const char type = char(hdr[0]);
+        const size_t len = hdr[1] | (hdr[2] << 8);
+        payload.resize(len);
+        if (!read_all(fd, payload.data(), len))
+            break;
+
+        if (type == 'K') {
+            if (len < 2 || len != 2 + size_t(payload[0]) * payload[1]) {
+                fprintf(stderr, "bad keyframe\n");
+                return 1;
+            }
+            cols = payload[0];
+            pages = payload[1];
+            image.assign(payload.begin() + 2, payload.end());
+        } else if (type == 'D') {
+            if (image.empty()) {
+                fprintf(stderr, "delta before keyframe\n");
+                return 1;
+            }
+            size_t pos = 0;
+            for (size_t i = 0; i < len; ) {
+                const uint8_t code = payload[i++];
+                const size_t n = (code & 0x7f) + 1;
+                if (code & 0x80) {
+                    pos += n;
+                    continue;
+                }
+                if (i + n > len || pos + n > image.size()) {
+                    fprintf(stderr, "bad delta\n");
+                    return 1;
+                }
+                for (size_t k = 0; k < n; k++)
+                    image[pos++] ^= payload[i++];
+            }
+        } else {
+            continue; // not something we know; skip it
+        }
+
+        char name[4096];
+        if (numbered)
+            snprintf(name, sizeof(name), out, int(frames));
+        else
+            snprintf(name, sizeof(name), "%s", out);
+        if (!write_pbm(name, image, cols, pages))
+            return 1;
+        frames++;
+    }
+
+    fprintf(stderr, "%ld frames\n", frames);
+
+    return 0;
+}
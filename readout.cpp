@@ -0,0 +1,218 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "font_5x7.h"
+#include "oled_error.h"
+#include "readout.h"
+#include "ssd1306_128x64.h"
+#include "trace.h"
+
+
+// segments of each glyph, bit 0 = a ... bit 6 = g:
+//
+//    aaa
+//   f   b
+//    ggg
+//   e   c
+//    ddd
+static const uint8_t segments[] = {
+    0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f, // 0...9
+    0x00,   // ' '
+    0x40,   // '-'
+};
+
+
+// Set x1...x2, y1...y2 (inclusive) in a page-major bitmap w wide
+static void rect(uint8_t *bits, int w, int x1, int y1, int x2, int y2)
+{
+    for (int y = y1; y <= y2; y++)
+        for (int x = x1; x <= x2; x++)
+            bits[(y / 8) * w + x] |= uint8_t(1 << (y % 8));
+}
+
+
+Readout::Readout(int x, int y, int height, int cells, Style style) :
+    _x(x),
+    _y(y),
+    _height(height),
+    _cells(cells),
+    _glyph_w(0),
+    _dp_w(0),
+    _cell_w(0),
+    _glyph_bits(nullptr),
+    _dp_bits(nullptr),
+    _blank_bits(nullptr),
+    _shown(nullptr)
+{
+    const int min_height = (style == Style::Segment) ? 16 : 8;
+    if (height < min_height || height > Ssd1306_128x64::rows || height % 8 != 0)
+        OLED_INVALID("Readout: bad height");
+    if (cells < 1)
+        OLED_INVALID("Readout: no cells");
+
+    _shown = new uint8_t[_cells];
+    invalidate();
+
+    if (style == Style::Segment)
+        render_segment();
+    else
+        render_scaled();
+}
+
+
+Readout::~Readout()
+{
+    delete[] _glyph_bits;
+    delete[] _dp_bits;
+    delete[] _blank_bits;
+    delete[] _shown;
+}
+
+
+void Readout::invalidate()
+{
+    memset(_shown, 0xff, _cells);
+}
+
+
+// Segments t thick, in a glyph 9/16 as wide as it is high; the bottom few
+// rows are left blank so readouts can be stacked
+void Readout::render_segment()
+{
+    const int pages = _height / 8;
+    const int t = ((_height + 4) / 10 > 2) ? (_height + 4) / 10 : 2;
+    const int h = _height - ((_height / 16 > 1) ? _height / 16 : 1); // lit rows
+    const int w = _height * 9 / 16;
+    const int m = (h - t) / 2;  // top of g
+    const int gap = (t / 2 > 1) ? t / 2 : 1;
+
+    _glyph_w = w;
+    _dp_w = gap + t + gap;
+    _cell_w = _glyph_w + _dp_w;
+
+    _glyph_bits = new uint8_t[glyphs * w * pages]();
+    for (int g = 0; g < glyphs; g++) {
+        uint8_t *bits = _glyph_bits + g * w * pages;
+        const uint8_t s = segments[g];
+        if (s & 0x01) rect(bits, w, t, 0, w - t - 1, t - 1);                 // a
+        if (s & 0x02) rect(bits, w, w - t, t, w - 1, m - 1);                 // b
+        if (s & 0x04) rect(bits, w, w - t, m + t, w - 1, h - t - 1);         // c
+        if (s & 0x08) rect(bits, w, t, h - t, w - t - 1, h - 1);             // d
+        if (s & 0x10) rect(bits, w, 0, m + t, t - 1, h - t - 1);             // e
+        if (s & 0x20) rect(bits, w, 0, t, t - 1, m - 1);                     // f
+        if (s & 0x40) rect(bits, w, t, m, w - t - 1, m + t - 1);             // g
+    }
+
+    _dp_bits = new uint8_t[_dp_w * pages]();
+    rect(_dp_bits, _dp_w, gap, h - t, gap + t - 1, h - 1);
+    _blank_bits = new uint8_t[_dp_w * pages]();
+}
+
+
+// Each font pixel becomes an s x s block, s = height / 8
+void Readout::render_scaled()
+{
+    const int pages = _height / 8;
+    const int s = _height / 8;
+    const int w = 5 * s;
+    const int gap = (s / 2 > 1) ? s / 2 : 1;
+    const char chars[] = "0123456789 -";
+
+    _glyph_w = w;
+    _dp_w = gap + s + gap;
+    _cell_w = _glyph_w + _dp_w;
+
+    _glyph_bits = new uint8_t[glyphs * w * pages]();
+    for (int g = 0; g < glyphs; g++) {
+        uint8_t *bits = _glyph_bits + g * w * pages;
+        const uint8_t *col = font_5x7[int(chars[g])];
+        for (int i = 0; i < 5; i++)
+            for (int r = 0; r < 8; r++)
+                if (col[i] & (1 << r))
+                    rect(bits, w, i * s, r * s, i * s + s - 1, r * s + s - 1);
+    }
+
+    // on the font's baseline, row 6
+    _dp_bits = new uint8_t[_dp_w * pages]();
+    rect(_dp_bits, _dp_w, gap, 6 * s, gap + s - 1, 7 * s - 1);
+    _blank_bits = new uint8_t[_dp_w * pages]();
+}
+
+
+// glyph index for c
+int Readout::code(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c == '-')
+        return 11;
+    return 10;
+}
+
+
+int Readout::show(Ssd1306_128x64& oled, const char *s)
+{
+    OLED_TRACE_SCOPE(t, "readout");
+
+    // cells needed: one per character, except a '.' goes with the cell
+    // before it unless that one already has its point
+    int n = 0;
+    bool have_dp = true;
+    for (const char *c = s; *c != '\0'; c++) {
+        if (*c == '.' && !have_dp) {
+            have_dp = true;
+        } else {
+            n++;
+            have_dp = (*c == '.');
+        }
+    }
+
+    const int pages = _height / 8;
+    int drawn = 0;
+    auto put = [&](int i, uint8_t c) {
+        if (_shown[i] == c)
+            return;
+        const int x = _x + i * _cell_w;
+        oled.bitmap(x, _y, _glyph_bits + (c & ~dp) * _glyph_w * pages, _glyph_w, _height);
+        oled.bitmap(x + _glyph_w, _y, (c & dp) ? _dp_bits : _blank_bits, _dp_w, _height);
+        _shown[i] = c;
+        drawn++;
+    };
+
+    if (n > _cells) {
+        for (int i = 0; i < _cells; i++)
+            put(i, code('-'));
+        OLED_TRACE_ARG(t, "cells", drawn);
+        return drawn;
+    }
+
+    int i = 0;
+    for (; i < _cells - n; i++)
+        put(i, code(' '));
+
+    // each cell is put once its '.' (if any) has been seen
+    int pending = -1;
+    for (const char *c = s; *c != '\0'; c++) {
+        if (*c == '.' && pending >= 0 && !(pending & dp)) {
+            pending |= dp;
+            continue;
+        }
+        if (pending >= 0)
+            put(i++, uint8_t(pending));
+        pending = (*c == '.') ? (code(' ') | dp) : code(*c);
+    }
+    if (pending >= 0)
+        put(i++, uint8_t(pending));
+
+    OLED_TRACE_ARG(t, "cells", drawn);
+    return drawn;
+}
+
+
+int Readout::show(Ssd1306_128x64& oled, long v)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return show(oled, buf);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+class Ssd1306_128x64;
+
+
+// Big numeric readout
+//
+// A row of fixed-width character cells showing a number in 7-segment style
+// digits, or the 5x7 font's digits scaled up, 8 to 64 pixels high. Every
+// glyph is rendered once, in the constructor, into the display's page
+// layout, so drawing a cell is a copy of its columns.
+//
+// The readout remembers what each cell shows and show() draws only the
+// cells that change: a counter going from 41 to 42 redraws one cell, and
+// flush_dirty() then sends just that cell's columns.
+//
+// Characters are the digits, ' ' and '-'; anything else shows as ' '. A '.'
+// lights the decimal point of the cell before it, as on a real segment
+// display, so it takes no cell of its own. Text is right-aligned; text too
+// long for the cells shows as all '-'.
+//
+//   Readout temp(0, 16, 32, 5);     // 5 cells 32 px high at (0, 16)
+//   temp.show(oled, "21.5");
+//   oled.flush_dirty();
+
+class Readout
+{
+  public:
+
+    enum class Style {
+        Segment,    // 7 segments; height 16...64
+        Scaled,     // font_5x7 scaled by height/8; height 8...64
+    };
+
+    // (x, y) is the top left in viewport coordinates; height must be a
+    // multiple of 8
+    Readout(int x, int y, int height, int cells, Style style=Style::Segment);
+    ~Readout();
+
+    Readout(const Readout&) = delete;
+    Readout& operator=(const Readout&) = delete;
+
+    int width() const { return _cells * _cell_w; }
+    int height() const { return _height; }
+
+    // returns how many cells were drawn
+    int show(Ssd1306_128x64& oled, const char *s);
+    int show(Ssd1306_128x64& oled, long v);
+
+    // forget what the cells show, so the next show() draws them all (after
+    // something else has drawn over the readout, e.g. a clear())
+    void invalidate();
+
+  private:
+
+    static const int glyphs = 12;       // '0'...'9', ' ', '-'
+    static const uint8_t dp = 0x80;     // decimal point, or'd into a code
+
+    int _x, _y;
+    int _height;
+    int _cells;
+
+    // each cell is the glyph, then a strip for the decimal point
+    int _glyph_w;
+    int _dp_w;
+    int _cell_w;
+
+    // page-major, glyphs * _glyph_w * pages, and the lit decimal point strip
+    uint8_t *_glyph_bits;
+    uint8_t *_dp_bits;
+    uint8_t *_blank_bits;
+
+    // glyph index | dp, per cell; 0xff means unknown
+    uint8_t *_shown;
+
+    void render_segment();
+    void render_scaled();
+    static int code(char c);
+};
@@ -0,0 +1,172 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <semaphore.h>
+
+#include "display_list.h"
+#include "renderer.h"
+#include "ssd1306_128x64.h"
+#include "trace.h"
+
+
+Renderer::Renderer(Ssd1306_128x64& oled) :
+    _oled(oled),
+    _head(&_stub),
+    _tail(&_stub),
+    _free(0),
+    _stop(false),
+    _flushes(0)
+{
+    _stub.next.store(nullptr, std::memory_order_relaxed);
+    for (int i = 0; i < pool_size; i++) {
+        _pool[i].index = i;
+        release(&_pool[i]);
+    }
+    sem_init(&_wake, 0, 0);
+    _thread = std::thread(&Renderer::run, this);
+}
+
+
+Renderer::~Renderer()
+{
+    _stop.store(true, std::memory_order_release);
+    sem_post(&_wake);
+    _thread.join();
+    sem_destroy(&_wake);
+
+    // only if something was submitted while destroying, which is a bug
+    Node *n;
+    while ((n = pop()) != nullptr)
+        release(n);
+}
+
+
+void Renderer::submit(std::shared_ptr<const DisplayList> dl)
+{
+    Node *n = alloc();
+    n->dl = std::move(dl);
+    push(n);
+    sem_post(&_wake);
+}
+
+
+// Any thread
+Renderer::Node *Renderer::alloc()
+{
+    uint64_t top = _free.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t i = uint32_t(top);
+        if (i == 0) {
+            Node *n = new Node; // pool's all queued
+            n->index = -1;
+            return n;
+        }
+        Node *n = &_pool[i - 1];
+        const uint64_t next = ((top >> 32) + 1) << 32 |
+                              n->free_next.load(std::memory_order_relaxed);
+        if (_free.compare_exchange_weak(top, next, std::memory_order_acquire,
+                                        std::memory_order_acquire))
+            return n;
+    }
+}
+
+
+// Render thread (and constructor, destructor)
+void Renderer::release(Node *n)
+{
+    n->dl.reset();
+
+    if (n->index < 0) {
+        delete n;
+        return;
+    }
+
+    uint64_t top = _free.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        n->free_next.store(uint32_t(top), std::memory_order_relaxed);
+        next = (top & 0xffffffff00000000ull) | uint32_t(n->index + 1);
+    } while (!_free.compare_exchange_weak(top, next, std::memory_order_release,
+                                          std::memory_order_relaxed));
+}
+
+
+// Any thread
+void Renderer::push(Node *n)
+{
+    n->next.store(nullptr, std::memory_order_relaxed);
+    Node *prev = _head.exchange(n, std::memory_order_acq_rel);
+    // between the exchange and this store the list is briefly cut; pop()
+    // sees that as empty and tries again on the next wakeup
+    prev->next.store(n, std::memory_order_release);
+}
+
+
+// Render thread only; nullptr if nothing is ready
+Renderer::Node *Renderer::pop()
+{
+    Node *tail = _tail;
+    Node *next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &_stub) {
+        if (next == nullptr)
+            return nullptr;
+        _tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+        _tail = next;
+        return tail;
+    }
+
+    if (tail != _head.load(std::memory_order_acquire))
+        return nullptr; // a push is halfway done
+
+    // tail is the last node; put the stub behind it so it can be taken
+    push(&_stub);
+
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        _tail = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+
+void Renderer::run()
+{
+    while (true) {
+        sem_wait(&_wake);
+
+        // read before draining: a list submitted during the flush below
+        // still gets a pass of its own
+        const bool stop = _stop.load(std::memory_order_acquire);
+
+        // draw everything that's queued, then flush once
+        bool drawn = false;
+        Node *n;
+        while ((n = pop()) != nullptr) {
+            OLED_TRACE_SCOPE(t, "replay");
+            OLED_TRACE_ARG(t, "bytes", n->dl->size());
+            _oled.reset_viewport();
+            n->dl->replay(_oled);
+            release(n);
+            drawn = true;
+        }
+
+        if (drawn) {
+            _oled.reset_viewport();
+            _oled.flush();
+            _flushes.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // everything submitted before the destructor was drawn above
+        if (stop)
+            break;
+    }
+}
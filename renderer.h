@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <semaphore.h>
+
+class DisplayList;
+class Ssd1306_128x64;
+
+
+// Render thread
+//
+// Any number of threads submit() display lists; one thread owns the
+// display, replays the lists in the order they were submitted, and
+// flushes. Submitting never waits for a flush: the queue is a lock-free
+// linked list (Vyukov's intrusive MPSC queue), and producers only do an
+// atomic exchange and a store. Whatever has queued up while a flush is in
+// progress is drawn together and flushed once.
+//
+// Nor does submitting allocate: queue nodes come from a pool in the
+// Renderer, taken and given back through a lock-free stack. Only with more
+// than pool_size lists queued at once does submit() fall back to new.
+//
+// Every list starts with the whole display as the viewport, so one list's
+// viewport doesn't leak into the next.
+//
+// Once a Renderer is running, only its thread may touch the display.
+
+class Renderer
+{
+  public:
+
+    Renderer(Ssd1306_128x64& oled);
+    ~Renderer();    // stops, after drawing what was already submitted
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // The list is shared, not copied, so a cached list can be submitted
+    // again and again.
+    void submit(std::shared_ptr<const DisplayList> dl);
+
+    // number of flushes so far
+    long flushes() const { return _flushes.load(std::memory_order_relaxed); }
+
+  private:
+
+    struct Node {
+        std::atomic<Node *> next;
+        std::shared_ptr<const DisplayList> dl;
+        int index;                          // in _pool, or -1 if from new
+        std::atomic<uint32_t> free_next;    // on the free stack, as in _free
+    };
+
+    static const int pool_size = 64;
+
+    Ssd1306_128x64& _oled;
+
+    // producers push at _head, the render thread pops at _tail; _stub keeps
+    // the list from ever being empty
+    std::atomic<Node *> _head;
+    Node *_tail;
+    Node _stub;
+
+    // free nodes: the low 32 bits are the top node's index + 1 (0 when
+    // empty), the high 32 count pops, so a pop that raced with others and
+    // saw a stale top fails its compare-exchange instead of corrupting the
+    // stack
+    Node _pool[pool_size];
+    std::atomic<uint64_t> _free;
+
+    sem_t _wake;
+    std::atomic<bool> _stop;
+    std::atomic<long> _flushes;
+
+    std::thread _thread;
+
+    Node *alloc();
+    void release(Node *n);
+    void push(Node *n);
+    Node *pop();
+    void run();
+};
@@ -3,44 +3,57 @@
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
-#include <stdexcept>
 #include <iostream>
 #include "i2c_dev.h"
+#include "font_file.h"
+#include "mirror.h"
+#include "oled_error.h"
 #include "ssd1306_128x64.h"
+#include "surface.h"
+#include "trace.h"
 
 using std::cout;
 using std::endl;
-using std::invalid_argument;
 
 
-Ssd1306_128x64::Ssd1306_128x64(I2cDev& i2c_dev) :
-    _i2c_dev(i2c_dev)
+// The whole setup goes as one command stream (one i2c transaction).
+//
+// warm=true is for attaching to a controller that is already running, e.g.
+// after the program restarts: the display is not turned off, and the
+// settings are sent again (they're the same, so the picture doesn't change)
+// in case the controller was reset. Whatever is on the panel stays until
+// the first flush() or flush_dirty() replaces it, so there is no blank frame
+// and no flicker.
+Ssd1306_128x64::Ssd1306_128x64(I2cDev& i2c_dev, bool warm) :
+    _i2c_dev(i2c_dev),
+    _mirror(nullptr),
+    _off(false)
 {
     memset(_image, 0, sizeof(_image));
-
-    off(); // display off
-
-    write_cmd(0xa8, 0x3f);  // mux ratio 64 (reset value)
-
-    write_cmd(0x8d, 0x14);  // charge pump regulator enabled
-
-    // flip vertically or not ([0xc0], 0xc8)
-    if (flip_v)
-        write_cmd(0xc8);
+    dirty_all(); // controller RAM is whatever it was, not this
+
+    reset_viewport();
+
+    uint8_t init[] = {
+        0xae,           // display off
+        0xa8, 0x3f,     // mux ratio 64 (reset value)
+        0x8d, 0x14,     // charge pump regulator enabled
+        // flip vertically or not ([0xc0], 0xc8)
+        uint8_t(flip_v ? 0xc8 : 0xc0),
+        // flip horizontally or not ([0xa0], 0xa1)
+        uint8_t(flip_h ? 0xa1 : 0xa0),
+        0xda, 0x12,     // sequential com pins, no l/r remap
+                        // (0xda,0x02, [0xda/0x12], 0xda/0x22, 0xda/0x32)
+        0xd9, 0x22,     // precharge periods (0xf1?)
+                        // [0xd9,0x22]
+        0x20, 0x00,     // horizontal addressing, so a window of pages
+                        // can be written as one stream of data
+    };
+
+    if (warm)
+        write_cmd(init + 1, sizeof(init) - 1); // all but display off
     else
-        write_cmd(0xc0);
-
-    // flip horizontally or not ([0xa0], 0xa1)
-    if (flip_h)
-        write_cmd(0xa1);
-    else
-        write_cmd(0xa0);
-
-    write_cmd(0xda, 0x12);  // sequential com pins, no l/r remap
-                            // (0xda,0x02, [0xda/0x12], 0xda/0x22, 0xda/0x32)
-
-    write_cmd(0xd9, 0x22);  // precharge periods (0xf1?)
-                            // [0xd9,0x22]
+        write_cmd(init, sizeof(init));
 }
 
 
@@ -72,75 +85,313 @@ void Ssd1306_128x64::write_cmd(uint8_t cmd1, uint8_t cmd2)
 }
 
 
-void Ssd1306_128x64::write_data(uint8_t *buf, int buf_len)
+void Ssd1306_128x64::write_cmd(uint8_t *buf, int buf_len)
 {
-    const uint8_t ctrl = 0x40;
+    const uint8_t ctrl = 0x00;
     _i2c_dev.write(ctrl, buf, buf_len);
 }
 
 
-void Ssd1306_128x64::page(int p)
+void Ssd1306_128x64::write_data(uint8_t *buf, int buf_len)
 {
-    if (p < 0 || p >= pages)
-        throw invalid_argument("page: page out of range");
-
-    write_cmd(0xb0 | (p & 0x7));
+    const uint8_t ctrl = 0x40;
+    _i2c_dev.write(ctrl, buf, buf_len);
 }
 
 
-void Ssd1306_128x64::column(int c)
+// Data written after this fills columns c1...c2 of page p1, then the same
+// columns of the next page, and so on to p2 (then wraps to the start)
+void Ssd1306_128x64::window(int c1, int c2, int p1, int p2)
 {
-    if (c < 0 || c >= cols)
-        throw invalid_argument("column: column out of range");
-
-    write_cmd(0x10 | ((c >> 4) & 0xf), c & 0xf);
+    OLED_TRACE_SCOPE(t, "window");
+    OLED_TRACE_ARG(t, "cols", c2 - c1 + 1);
+    OLED_TRACE_ARG(t, "pages", p2 - p1 + 1);
+    assert(c1 >= 0 && c1 <= c2 && c2 < cols);
+    assert(p1 >= 0 && p1 <= p2 && p2 < pages);
+
+    uint8_t buf[] = {
+        0x21, uint8_t(c1), uint8_t(c2), // column range
+        0x22, uint8_t(p1), uint8_t(p2), // page range
+    };
+    write_cmd(buf, sizeof(buf));
 }
 
 
 void Ssd1306_128x64::on()
 {
+    OLED_TRACE_SCOPE(t, "on");
     write_cmd(0xaf);
+    _off = false;
 }
 
 
 void Ssd1306_128x64::off()
 {
+    OLED_TRACE_SCOPE(t, "off");
     write_cmd(0xae);
+    _off = true;
+}
+
+
+void Ssd1306_128x64::contrast(uint8_t level)
+{
+    OLED_TRACE_SCOPE(t, "contrast");
+    write_cmd(0x81, level);
+}
+
+
+void Ssd1306_128x64::invert(bool inv)
+{
+    OLED_TRACE_SCOPE(t, "invert");
+    write_cmd(inv ? 0xa7 : 0xa6);
+}
+
+
+void Ssd1306_128x64::entire_on(bool lit)
+{
+    OLED_TRACE_SCOPE(t, "entire_on");
+    write_cmd(lit ? 0xa5 : 0xa4);
 }
 
 
 void Ssd1306_128x64::clear()
 {
+    OLED_TRACE_SCOPE(t, "clear");
     memset(_image, 0, sizeof(_image));
+    dirty_all();
 }
 
 
-void Ssd1306_128x64::flush()
+void Ssd1306_128x64::dirty_all()
 {
     for (int p = 0; p < pages; p++) {
-        page(p);
-        column(0);
-        write_data(_image[p], cols);
+        _dirty_x1[p] = 0;
+        _dirty_x2[p] = cols - 1;
     }
 }
 
 
+void Ssd1306_128x64::clean_all()
+{
+    for (int p = 0; p < pages; p++) {
+        _dirty_x1[p] = cols;
+        _dirty_x2[p] = -1;
+    }
+}
+
+
+// The whole image is one write; I2cDev splits it into as few transfers as
+// the adapter allows
+void Ssd1306_128x64::flush()
+{
+    OLED_TRACE_SCOPE(t, "flush");
+    if (_off) {
+        dirty_all(); // for flush_dirty() before on()
+        return;
+    }
+    OLED_TRACE_ARG(t, "bytes", sizeof(_image));
+    window(0, cols - 1, 0, pages - 1);
+    write_data(&_image[0][0], sizeof(_image));
+    clean_all();
+
+    if (_mirror != nullptr)
+        _mirror->frame(&_image[0][0]);
+}
+
+
+// A window is a transfer of its own (address, control byte and 6 command
+// bytes) and the data transfer has its own address and control byte; call
+// it this many data bytes, to allow for the ioctl too
+static const int window_cost = 16;
+
+
+void Ssd1306_128x64::flush_dirty(bool force)
+{
+    OLED_TRACE_SCOPE(t, "flush_dirty");
+    if (_off && !force)
+        return; // still dirty, for before on()
+
+    uint8_t buf[pages * cols];
+    int sent = 0;
+
+    int p1 = 0;
+    while (p1 < pages) {
+        if (_dirty_x1[p1] > _dirty_x2[p1]) {
+            p1++;
+            continue;
+        }
+
+        // take the next page into the window while that costs no more than
+        // giving it a window of its own
+        int x1 = _dirty_x1[p1];
+        int x2 = _dirty_x2[p1];
+        int cost = window_cost + (x2 - x1 + 1);
+        int p2 = p1;
+        while (p2 + 1 < pages && _dirty_x1[p2 + 1] <= _dirty_x2[p2 + 1]) {
+            const int q = p2 + 1;
+            const int nx1 = (_dirty_x1[q] < x1) ? _dirty_x1[q] : x1;
+            const int nx2 = (_dirty_x2[q] > x2) ? _dirty_x2[q] : x2;
+            const int merged = window_cost + (nx2 - nx1 + 1) * (q - p1 + 1);
+            const int apart = cost + window_cost + (_dirty_x2[q] - _dirty_x1[q] + 1);
+            if (merged > apart)
+                break;
+            x1 = nx1;
+            x2 = nx2;
+            cost = merged;
+            p2 = q;
+        }
+
+        const int w = x2 - x1 + 1;
+        uint8_t *b = buf;
+        for (int p = p1; p <= p2; p++) {
+            memcpy(b, &_image[p][x1], w);
+            b += w;
+            _dirty_x1[p] = cols;
+            _dirty_x2[p] = -1;
+        }
+        window(x1, x2, p1, p2);
+        write_data(buf, b - buf);
+        sent += b - buf;
+
+        p1 = p2 + 1;
+    }
+
+    OLED_TRACE_ARG(t, "bytes", sent);
+
+    if (_mirror != nullptr)
+        _mirror->frame(&_image[0][0]);
+}
+
+
+void Ssd1306_128x64::viewport(int x, int y, int w, int h)
+{
+    _org_x = x;
+    _org_y = y;
+    _vp_x1 = x;
+    _vp_y1 = y;
+    _vp_x2 = x + w - 1;
+    _vp_y2 = y + h - 1;
+    set_clip(_vp_x1, _vp_y1, _vp_x2, _vp_y2);
+}
+
+
+void Ssd1306_128x64::clip(int x1, int y1, int x2, int y2)
+{
+    if (x1 > x2) {
+        // swap
+        int t = x1;
+        x1 = x2;
+        x2 = t;
+    }
+
+    if (y1 > y2) {
+        // swap
+        int t = y1;
+        y1 = y2;
+        y2 = t;
+    }
+
+    set_clip(_org_x + x1, _org_y + y1, _org_x + x2, _org_y + y2);
+}
+
+
+void Ssd1306_128x64::reset_viewport()
+{
+    viewport(0, 0, cols, rows);
+}
+
+
+// absolute coordinates; intersect with the viewport and the display
+void Ssd1306_128x64::set_clip(int x1, int y1, int x2, int y2)
+{
+    if (x1 < _vp_x1) x1 = _vp_x1;
+    if (x1 < 0) x1 = 0;
+    if (x2 > _vp_x2) x2 = _vp_x2;
+    if (x2 > cols - 1) x2 = cols - 1;
+    if (y1 < _vp_y1) y1 = _vp_y1;
+    if (y2 > _vp_y2) y2 = _vp_y2;
+
+    _clip_x1 = x1;
+    _clip_x2 = x2;
+
+    // an empty x range has x1 > x2 and every loop over it does nothing;
+    // an empty y range leaves every mask zero
+    for (int p = 0; p < pages; p++)
+        _clip_mask[p] = rows_mask(p, y1, y2);
+}
+
+
+// bits of page p that are rows y1...y2 (absolute, inclusive)
+uint8_t Ssd1306_128x64::rows_mask(int p, int y1, int y2)
+{
+    int lo = y1 - p * 8;
+    int hi = y2 - p * 8;
+    if (lo < 0) lo = 0;
+    if (hi > 7) hi = 7;
+    if (lo > hi)
+        return 0;
+    return (0xff >> (7 - hi)) & (0xff << lo);
+}
+
+
 // set or clear a pixel
 void Ssd1306_128x64::set(int x, int y, int d)
 {
-    if (x < 0 || x >= cols)
-        throw invalid_argument("set: x out of range");
-
-    if (y < 0 || y >= rows)
-        throw invalid_argument("set: y out of range");
+    OLED_TRACE_SCOPE(t, "set");
+    x += _org_x;
+    y += _org_y;
 
-    if (d != 0 && d != 1)
-        throw invalid_argument("set: d out of range");
+    if (x < _clip_x1 || x > _clip_x2 || y < 0 || y >= rows)
+        return;
 
     int p = y / 8;
-    assert(p < pages);
-    uint8_t b = d << (y % 8);
-    _image[p][x] |= b;
+    uint8_t b = (1 << (y % 8)) & _clip_mask[p];
+    if (b == 0)
+        return; // row is outside the clip
+
+    if (d)
+        _image[p][x] |= b;
+    else
+        _image[p][x] &= ~b;
+    dirty(p, x, x);
+}
+
+
+// Write n columns of 8 vertical pixels each, top at absolute (x, y),
+// replacing what was there (only the rows in mask, if given). y does not have
+// to be page-aligned, in which case each column straddles two pages. All the
+// clipping is done up front: the column range is trimmed, and each page gets
+// a mask of the bits that are both under the column and inside the clip.
+void Ssd1306_128x64::put_cols(int x, int y, const uint8_t *col, int n, uint8_t mask)
+{
+    int i1 = _clip_x1 - x;
+    int i2 = _clip_x2 - x + 1;
+    if (i1 < 0) i1 = 0;
+    if (i2 > n) i2 = n;
+    if (i1 >= i2 || y <= -8 || y >= rows)
+        return;
+
+    // page for upper part of the column (lower is p1 + 1); y + 8 > 0 here,
+    // so this rounds down even for negative y
+    const int p1 = (y + 8) / 8 - 1;
+    const int sh = y - p1 * 8;
+
+    const uint8_t m1 = (p1 >= 0) ? uint8_t((mask << sh) & _clip_mask[p1]) : 0;
+    const uint8_t m2 = (sh != 0 && p1 + 1 < pages) ? uint8_t((mask >> (8 - sh)) & _clip_mask[p1 + 1]) : 0;
+
+    if (m1 != 0) {
+        uint8_t *img = _image[p1];
+        for (int i = i1; i < i2; i++)
+            img[x + i] = (img[x + i] & ~m1) | ((col[i] << sh) & m1);
+        dirty(p1, x + i1, x + i2 - 1);
+    }
+
+    if (m2 != 0) {
+        uint8_t *img = _image[p1 + 1];
+        for (int i = i1; i < i2; i++)
+            img[x + i] = (img[x + i] & ~m2) | ((col[i] >> (8 - sh)) & m2);
+        dirty(p1 + 1, x + i1, x + i2 - 1);
+    }
 }
 
 
@@ -150,20 +401,15 @@ void Ssd1306_128x64::set(int x, int y, int d)
 // row = 0 ... 7 (for 64 pixels high)
 void Ssd1306_128x64::putc(int col, int row, char c, uint8_t font[128][5])
 {
-    if (col < 0 || col >= (cols / 6))
-        throw invalid_argument("putc: col out of range");
-
-    if (row < 0 || row >= (rows / 8))
-        throw invalid_argument("putc: row out of range");
-
-    for (int i = 0; i < 5; i++)
-        _image[row][col * 6 + i] = font[int(c)][i];
+    OLED_TRACE_SCOPE(t, "putc");
+    put_cols(_org_x + col * 6, _org_y + row * 8, font[c & 0x7f], 5);
 }
 
 
 // col=0: left-aligned; col=-1: right-aligned; col=-2: centered
 void Ssd1306_128x64::puts(int col, int row, const char *s, uint8_t font[128][5])
 {
+    OLED_TRACE_SCOPE(t, "puts");
     const int s_len = strlen(s);
     if (col == -1) // right
         col = 21 - s_len;
@@ -178,28 +424,26 @@ void Ssd1306_128x64::puts(int col, int row, const char *s, uint8_t font[128][5])
 // col, row is still the position of a single-sized character
 void Ssd1306_128x64::putc2(int col, int row, char c, uint8_t font[128][5])
 {
+    OLED_TRACE_SCOPE(t, "putc2");
     //cout << "putc2(col=" << col << ",row=" << row << ",c=" << int(c) << ",font)" << endl;
 
-    if (col < 0 || col >= (cols / 6 - 1))
-        throw invalid_argument("putc2: col out of range");
-
-    if (row < 0 || row >= (rows / 8 - 1))
-        throw invalid_argument("putc2: row out of range");
+    uint8_t lo[10];
+    uint8_t hi[10];
 
     for (int i = 0; i < 5; i++) {
-        const uint8_t lo = lo2(font[int(c)][i]);
-        _image[row][col*6 + 2*i] = lo;
-        _image[row][col*6 + 2*i+1] = lo;
-        const uint8_t hi = hi2(font[int(c)][i]);
-        _image[row+1][col*6 + 2*i] = hi;
-        _image[row+1][col*6 + 2*i+1] = hi;
+        lo[2*i] = lo[2*i+1] = lo2(font[c & 0x7f][i]);
+        hi[2*i] = hi[2*i+1] = hi2(font[c & 0x7f][i]);
     }
+
+    put_cols(_org_x + col * 6, _org_y + row * 8, lo, 10);
+    put_cols(_org_x + col * 6, _org_y + row * 8 + 8, hi, 10);
 }
 
 
 // col=0: left-aligned; col=-1: right-aligned; col=-2: centered
 void Ssd1306_128x64::puts2(int col, int row, const char *s, uint8_t font[128][5])
 {
+    OLED_TRACE_SCOPE(t, "puts2");
     const int s_len = strlen(s);
 
     if (col == -1) // right
@@ -240,87 +484,119 @@ uint8_t Ssd1306_128x64::hi2(uint8_t b)
 // 5x7 characters are put in 6x8 cells
 // x = 0 ... 123 (for 128 pixels wide) (123 + 5 = 128)
 // y = 0 ... 57 (for 64 pixels high) (57 + 7 = 64)
+// anything outside that is clipped
 void Ssd1306_128x64::putc_at(int x, int y, char c, uint8_t font[128][5])
 {
-    if (x < 0 || x > (cols - 5))
-        throw invalid_argument("putc_at: x out of range");
+    OLED_TRACE_SCOPE(t, "putc_at");
+    put_cols(_org_x + x, _org_y + y, font[c & 0x7f], 5);
+}
 
-    if (y < 0 || y > (rows - 7))
-        throw invalid_argument("putc_at: y out of range");
 
-    // page for upper part of character (lower is p1 + 1)
-    int p1 = y / 8;
-    assert(p1 < pages);
+// string at (x, y) pixel coordinates, 6 pixels per character
+// x can be negative, e.g. to scroll text off the left edge
+void Ssd1306_128x64::puts_at(int x, int y, const char *s, uint8_t font[128][5])
+{
+    OLED_TRACE_SCOPE(t, "puts_at");
+    x += _org_x;
+    y += _org_y;
 
-    // bits from character used in upper part (lower is ~b1)
-    uint8_t b1 = 0xff >> (y % 8);
+    // skip what is entirely left of the clip, stop once past the right
+    for (; *s != '\0' && x + 5 <= _clip_x1; s++)
+        x += 6;
 
-    // bits in upper page where character goes (lower is ~m1)
-    uint8_t m1 = 0xff << (y % 8);
-    
-    for (int i = 0; i < 5; i++) {
-        // clear bits in image
-        _image[p1][x + i] &= ~m1;
-        if (p1 < (pages - 1))
-            _image[p1 + 1][x + i] &= m1;
-        // insert bits from char into image
-        _image[p1][x + i] |= ((font[int(c)][i] & b1) << (y % 8));
-        if (p1 < (pages - 1))
-            _image[p1 + 1][x + i] |= ((font[int(c)][i] & ~b1) >> (8 - (y % 8)));
+    for (; *s != '\0' && x <= _clip_x2; s++) {
+        put_cols(x, y, font[*s & 0x7f], 5);
+        x += 6;
     }
 }
 
 
-// horizontal line from (x1, y) to (x2, y), including endpoints
-void Ssd1306_128x64::hline(int x1, int x2, int y)
+int Ssd1306_128x64::putc_at(int x, int y, uint32_t cp, const FontFile& font)
 {
-    if (x1 < 0 || x1 >= cols)
-        throw invalid_argument("hline: x1 out of range");
+    OLED_TRACE_SCOPE(t, "putc_at");
+    const FontFile::Glyph *g = font.find(cp);
+    if (g == nullptr)
+        return x;
 
-    if (x2 < 0 || x2 >= cols)
-        throw invalid_argument("hline: x2 out of range");
+    // the bitmap is in 8-row bands, the last one maybe partial
+    bitmap(x + g->x_off, y + g->y_off, g->bits(), g->width, g->height);
+
+    return x + g->advance;
+}
 
-    if (y < 0 || y >= rows)
-        throw invalid_argument("hline: y out of range");
 
+int Ssd1306_128x64::puts_at(int x, int y, const char *s, const FontFile& font)
+{
+    OLED_TRACE_SCOPE(t, "puts_at");
+    while (*s != '\0')
+        x = putc_at(x, y, utf8_next(s), font);
+    return x;
+}
+
+
+// horizontal line from (x1, y) to (x2, y), including endpoints
+void Ssd1306_128x64::hline(int x1, int x2, int y)
+{
+    OLED_TRACE_SCOPE(t, "hline");
     if (x1 > x2) {
         // swap
-        int t = x1;
+        int tmp = x1;
         x1 = x2;
-        x2 = t;
+        x2 = tmp;
     }
 
+    x1 += _org_x;
+    x2 += _org_x;
+    y += _org_y;
+
+    if (y < 0 || y >= rows)
+        return;
+
+    if (x1 < _clip_x1) x1 = _clip_x1;
+    if (x2 > _clip_x2) x2 = _clip_x2;
+
+    const int p = y / 8;
+    const uint8_t b = (1 << (y % 8)) & _clip_mask[p];
+    if (b == 0 || x1 > x2)
+        return;
+
+    dirty(p, x1, x2);
     while (x1 <= x2)
-        set(x1++, y);
+        _image[p][x1++] |= b;
 }
 
 
 // vertical line from (x, y1) to (x, y2), including endpoints
 void Ssd1306_128x64::vline(int x, int y1, int y2)
 {
-    if (x < 0 || x >= cols)
-        throw invalid_argument("vline: x out of range");
-
-    if (y1 < 0 || y1 >= rows)
-        throw invalid_argument("vline: y1 out of range");
-
-    if (y2 < 0 || y2 >= rows)
-        throw invalid_argument("vline: y2 out of range");
+    OLED_TRACE_SCOPE(t, "vline");
+    x += _org_x;
+    if (x < _clip_x1 || x > _clip_x2)
+        return;
 
     if (y1 > y2) {
         // swap
-        int t = y1;
+        int tmp = y1;
         y1 = y2;
-        y2 = t;
+        y2 = tmp;
     }
 
-    while (y1 <= y2)
-        set(x, y1++);
+    y1 += _org_y;
+    y2 += _org_y;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t m = rows_mask(p, y1, y2) & _clip_mask[p];
+        if (m == 0)
+            continue;
+        _image[p][x] |= m;
+        dirty(p, x, x);
+    }
 }
 
 
 void Ssd1306_128x64::box(int x1, int y1, int x2, int y2)
 {
+    OLED_TRACE_SCOPE(t, "box");
     hline(x1, x2, y1);
     hline(x1, x2, y2);
     vline(x1, y1, y2);
@@ -328,25 +604,84 @@ void Ssd1306_128x64::box(int x1, int y1, int x2, int y2)
 }
 
 
-void Ssd1306_128x64::fill(int x1, int y1, int x2, int y2)
+// fill (d=1) or clear (d=0) a rectangle, including edges
+void Ssd1306_128x64::fill(int x1, int y1, int x2, int y2, int d)
 {
+    OLED_TRACE_SCOPE(t, "fill");
     if (x1 > x2) {
         // swap
-        int t = x1;
+        int tmp = x1;
         x1 = x2;
-        x2 = t;
+        x2 = tmp;
     }
 
     if (y1 > y2) {
         // swap
-        int t = y1;
+        int tmp = y1;
         y1 = y2;
-        y2 = t;
+        y2 = tmp;
     }
 
-    while (y1 <= y2) {
-        for (int x = x1; x <= x2; x++)
-            set(x, y1);
-        y1++;
+    x1 += _org_x;
+    x2 += _org_x;
+    y1 += _org_y;
+    y2 += _org_y;
+
+    if (x1 < _clip_x1) x1 = _clip_x1;
+    if (x2 > _clip_x2) x2 = _clip_x2;
+
+    if (x1 > x2)
+        return;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t m = rows_mask(p, y1, y2) & _clip_mask[p];
+        if (m == 0)
+            continue;
+        dirty(p, x1, x2);
+        if (d) {
+            for (int x = x1; x <= x2; x++)
+                _image[p][x] |= m;
+        } else {
+            for (int x = x1; x <= x2; x++)
+                _image[p][x] &= ~m;
+        }
+    }
+}
+
+
+// bits is the top band (rows 0...7, LSB on top) left to right, then the
+// next band, and so on; the last band may be partial
+void Ssd1306_128x64::bitmap(int x, int y, const uint8_t *bits, int width, int height)
+{
+    OLED_TRACE_SCOPE(t, "bitmap");
+    x += _org_x;
+    y += _org_y;
+    for (int r = 0; r < height; r += 8) {
+        const int n = height - r;
+        const uint8_t mask = (n >= 8) ? 0xff : (0xff >> (8 - n));
+        put_cols(x, y + r, bits, width, mask);
+        bits += width;
     }
 }
+
+
+void Ssd1306_128x64::blit(const Surface1& s)
+{
+    OLED_TRACE_SCOPE(t, "blit");
+    if (s.width() != cols || s.height() != rows)
+        OLED_INVALID("blit: surface size mismatch");
+
+    rows1_to_pages(s.data(), s.stride(), &_image[0][0], cols, pages);
+    dirty_all();
+}
+
+
+void Ssd1306_128x64::blit(const Surface8& s)
+{
+    OLED_TRACE_SCOPE(t, "blit");
+    if (s.width() != cols || s.height() != rows)
+        OLED_INVALID("blit: surface size mismatch");
+
+    rows8_to_pages(s.data(), s.stride(), &_image[0][0], cols, pages);
+    dirty_all();
+}
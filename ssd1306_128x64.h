@@ -3,21 +3,64 @@
 #include <cstdint>
 
 class I2cDev;
+class FontFile;
+class Mirror;
+class Surface1;
+class Surface8;
 
 
 class Ssd1306_128x64
 {
   public:
 
-    Ssd1306_128x64(I2cDev& i2c_dev);
+    // warm=true: the controller is already set up and showing something;
+    // leave it on and don't blank it (see the .cpp). Either way the whole
+    // image starts dirty, so the first flush_dirty() sends a full frame just
+    // as flush() does: about 24 ms of bus time at 400 kHz, so a warm attach
+    // does not get a picture up in under 10 ms; that takes a 1 MHz bus
+    Ssd1306_128x64(I2cDev& i2c_dev, bool warm=false);
 
     static const int rows = 64;
     static const int cols = 128;
 
+    // After off(), flush() and flush_dirty() send nothing (the panel is
+    // dark anyway) and leave the image dirty; on() only lights the panel
+    // again. Send what was held back first, with flush_dirty(true), so the
+    // panel lights up showing the current image rather than the old one.
+    // A newly constructed display flushes as usual.
     void on();
     void off();
+    bool is_off() const { return _off; }
+
+    // One command each, no flush: the controller does the work, so dimming,
+    // inverting or blinking costs a couple of bytes instead of a frame.
+    void contrast(uint8_t level);       // reset value 0x7f
+    void invert(bool inv=true);         // lit pixels dark, dark ones lit
+    void entire_on(bool lit=true);      // every pixel lit, image kept
+
     void clear();
     void flush();
+
+    // Send only what was drawn on since the last flush: every drawing call
+    // marks the columns it touched, per page, whether or not it changed any
+    // pixels. Runs of pages go as one window where that's cheaper than one
+    // window each. force sends even while off (the controller takes writes
+    // to its RAM with the panel dark).
+    void flush_dirty(bool force=false);
+
+    // Also send each flushed frame to m (mirror.h); nullptr stops that. The
+    // mirror must outlive the display, or be detached first.
+    void mirror(Mirror *m) { _mirror = m; }
+
+    // Drawing coordinates are relative to the viewport origin, and nothing
+    // is drawn outside the viewport or the clip rectangle. Anything off the
+    // edge is dropped silently, so text can be scrolled partly out of view.
+    // viewport() resets the clip rectangle to the whole viewport; clip()
+    // takes viewport coordinates, inclusive. blit() ignores both.
+    void viewport(int x, int y, int w, int h);
+    void clip(int x1, int y1, int x2, int y2);
+    void reset_viewport();
+
     void set(int x, int y, int d=1);
     void putc(int col, int row, char c, uint8_t font[128][5]);
     void puts(int col, int row, const char *s, uint8_t font[128][5]);
@@ -25,10 +68,21 @@ class Ssd1306_128x64
     // col=0: left-aligned; col=-1: right-aligned; col=-2: centered
     void puts2(int col, int row, const char *s, uint8_t font[128][5]);
     void putc_at(int x, int y, char c, uint8_t font[128][5]);
+    void puts_at(int x, int y, const char *s, uint8_t font[128][5]);
+    // proportional font; (x, y) is the pen at the top of the line, and the
+    // return is the pen's x afterwards; s is UTF-8
+    int putc_at(int x, int y, uint32_t cp, const FontFile& font);
+    int puts_at(int x, int y, const char *s, const FontFile& font);
     void hline(int x1, int x2, int y);
     void vline(int x, int y1, int y2);
     void box(int x1, int y1, int x2, int y2);
-    void fill(int x1, int y1, int x2, int y2);
+    void fill(int x1, int y1, int x2, int y2, int d=1);
+    // width x height pixels in 8-row bands (like FontFile glyphs), replacing
+    // what is under them; fastest with y a multiple of 8
+    void bitmap(int x, int y, const uint8_t *bits, int width, int height);
+    // replace the whole image with a row-major surface the size of the display
+    void blit(const Surface1& s);
+    void blit(const Surface8& s);
 
   private:
 
@@ -37,17 +91,47 @@ class Ssd1306_128x64
 
     I2cDev& _i2c_dev;
 
+    Mirror *_mirror;
+
+    // off() was called, and on() not since
+    bool _off;
+
     static const int pages = rows / 8;
 
     uint8_t _image[pages][cols];
 
+    // viewport origin and rectangle, absolute, inclusive
+    int _org_x, _org_y;
+    int _vp_x1, _vp_y1, _vp_x2, _vp_y2;
+
+    // effective clip: absolute columns (inclusive), and for each page
+    // which of its 8 rows may be drawn
+    int _clip_x1, _clip_x2;
+    uint8_t _clip_mask[pages];
+
+    // columns drawn on since the last flush, per page; x1 > x2 if none
+    int _dirty_x1[pages], _dirty_x2[pages];
+
+    void dirty(int p, int x1, int x2)
+    {
+        if (x1 < _dirty_x1[p]) _dirty_x1[p] = x1;
+        if (x2 > _dirty_x2[p]) _dirty_x2[p] = x2;
+    }
+    void dirty_all();
+    void clean_all();
+
+    void set_clip(int x1, int y1, int x2, int y2);
+    void put_cols(int x, int y, const uint8_t *col, int n, uint8_t mask=0xff);
+
     void write_cmd(uint8_t cmd);
     void write_cmd(uint8_t cmd1, uint8_t cmd2);
+    void write_cmd(uint8_t *buf, int buf_len);
     void write_data(uint8_t *buf, int buf_len);
 
-    void page(int p);
-    void column(int c);
+    // columns c1...c2 of pages p1...p2, inclusive
+    void window(int c1, int c2, int p1, int p2);
 
+    static uint8_t rows_mask(int p, int y1, int y2);
     static uint8_t lo2(uint8_t b);
     static uint8_t hi2(uint8_t b);
 };
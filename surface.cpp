@@ -0,0 +1,563 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "oled_error.h"
+#include "surface.h"
+
+
+Surface1::Surface1(int width, int height) :
+    _width(width),
+    _height(height),
+    _stride((width + 7) / 8),
+    _buf(nullptr)
+{
+    if (width <= 0 || height <= 0)
+        OLED_INVALID("Surface1: size out of range");
+
+    _buf = new uint8_t[_stride * _height];
+    clear();
+}
+
+
+Surface1::~Surface1()
+{
+    delete[] _buf;
+    _buf = nullptr;
+}
+
+
+void Surface1::clear()
+{
+    memset(_buf, 0, _stride * _height);
+}
+
+
+Surface8::Surface8(int width, int height) :
+    _width(width),
+    _height(height),
+    _buf(nullptr)
+{
+    if (width <= 0 || height <= 0)
+        OLED_INVALID("Surface8: size out of range");
+
+    _buf = new uint8_t[_width * _height];
+    clear();
+}
+
+
+Surface8::~Surface8()
+{
+    delete[] _buf;
+    _buf = nullptr;
+}
+
+
+void Surface8::clear()
+{
+    memset(_buf, 0, _width * _height);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Portable
+//
+// Gather the 8 row bytes of a block into a uint64 (row r in bits 8r...8r+7),
+// transpose with three delta swaps so bit 8r+c moves to 8c+r, then store it
+// high byte first. Storing reversed undoes the MSB-first pixel order of the
+// rows, so byte c of the output is column c with row r in bit r.
+
+static inline uint64_t transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc0000ccccull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+
+// one page, blocks [b1, b2)
+static void rows1_page_portable(const uint8_t *src, int stride, uint8_t *dst,
+                                int b1, int b2)
+{
+    for (int b = b1; b < b2; b++) {
+        uint64_t x = 0;
+        for (int r = 0; r < 8; r++)
+            x |= uint64_t(src[r * stride + b]) << (8 * r);
+        x = transpose8(x);
+        for (int c = 0; c < 8; c++)
+            dst[b * 8 + c] = uint8_t(x >> (56 - 8 * c));
+    }
+}
+
+
+// one page, columns [x1, x2)
+//
+// Eight columns at a time in a uint64: (v & 0x7f) + 0x7f sets the top bit of
+// each nonzero byte without carrying into the next one, so everything stays
+// byte-wise and byte order doesn't matter.
+static void rows8_page_portable(const uint8_t *src, int stride, uint8_t *dst,
+                                int x1, int x2)
+{
+    const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+
+    for (; x1 + 8 <= x2; x1 += 8) {
+        uint64_t acc = 0;
+        for (int r = 0; r < 8; r++) {
+            uint64_t v;
+            memcpy(&v, src + r * stride + x1, sizeof(v));
+            const uint64_t nz = ((v & lo7) + lo7) | v;
+            acc |= ((nz >> 7) & 0x0101010101010101ull) << r;
+        }
+        memcpy(dst + x1, &acc, sizeof(acc));
+    }
+
+    for (int x = x1; x < x2; x++) {
+        uint8_t b = 0;
+        for (int r = 0; r < 8; r++)
+            if (src[r * stride + x] != 0)
+                b |= (1 << r);
+        dst[x] = b;
+    }
+}
+
+
+static void rows1_portable(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    for (int p = 0; p < pages; p++)
+        rows1_page_portable(src + p * 8 * stride, stride, dst + p * cols, 0, cols / 8);
+}
+
+
+static void rows8_portable(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    for (int p = 0; p < pages; p++)
+        rows8_page_portable(src + p * 8 * stride, stride, dst + p * cols, 0, cols);
+}
+
+
+#if defined(__x86_64__)
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE2
+//
+// 1 bpp: load 16 bytes (128 pixels) from each of the page's 8 rows, then
+// interleave bytes, words and dwords so each register ends up holding two
+// blocks, each as its 8 row bytes in order. movemask then collects the MSB
+// of all 16 bytes, which is column 0 of both blocks; add the register to
+// itself to shift the next column up and repeat 8 times.
+//
+// 8 bpp: 16 columns at a time, OR in (1 << r) wherever row r is nonzero.
+
+static void rows1_sse2(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const int groups = cols / 128;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t *s = src + p * 8 * stride;
+        uint8_t *d = dst + p * cols;
+
+        for (int g = 0; g < groups; g++) {
+            __m128i r[8];
+            for (int i = 0; i < 8; i++)
+                r[i] = _mm_loadu_si128((const __m128i *)(s + i * stride + g * 16));
+
+            const __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+            const __m128i a1 = _mm_unpackhi_epi8(r[0], r[1]);
+            const __m128i a2 = _mm_unpacklo_epi8(r[2], r[3]);
+            const __m128i a3 = _mm_unpackhi_epi8(r[2], r[3]);
+            const __m128i a4 = _mm_unpacklo_epi8(r[4], r[5]);
+            const __m128i a5 = _mm_unpackhi_epi8(r[4], r[5]);
+            const __m128i a6 = _mm_unpacklo_epi8(r[6], r[7]);
+            const __m128i a7 = _mm_unpackhi_epi8(r[6], r[7]);
+
+            const __m128i b0 = _mm_unpacklo_epi16(a0, a2);
+            const __m128i b1 = _mm_unpackhi_epi16(a0, a2);
+            const __m128i b2 = _mm_unpacklo_epi16(a1, a3);
+            const __m128i b3 = _mm_unpackhi_epi16(a1, a3);
+            const __m128i b4 = _mm_unpacklo_epi16(a4, a6);
+            const __m128i b5 = _mm_unpackhi_epi16(a4, a6);
+            const __m128i b6 = _mm_unpacklo_epi16(a5, a7);
+            const __m128i b7 = _mm_unpackhi_epi16(a5, a7);
+
+            __m128i blk[8] = {
+                _mm_unpacklo_epi32(b0, b4), _mm_unpackhi_epi32(b0, b4),
+                _mm_unpacklo_epi32(b1, b5), _mm_unpackhi_epi32(b1, b5),
+                _mm_unpacklo_epi32(b2, b6), _mm_unpackhi_epi32(b2, b6),
+                _mm_unpacklo_epi32(b3, b7), _mm_unpackhi_epi32(b3, b7),
+            };
+
+            for (int j = 0; j < 8; j++) {
+                __m128i v = blk[j];
+                uint8_t *o = d + g * 128 + j * 16;
+                for (int c = 0; c < 8; c++) {
+                    const int m = _mm_movemask_epi8(v);
+                    o[c] = uint8_t(m);
+                    o[8 + c] = uint8_t(m >> 8);
+                    v = _mm_add_epi8(v, v);
+                }
+            }
+        }
+
+        rows1_page_portable(s, stride, d, groups * 16, cols / 8);
+    }
+}
+
+
+static void rows8_sse2(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const int x_end = cols & ~15;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t *s = src + p * 8 * stride;
+        uint8_t *d = dst + p * cols;
+
+        for (int x = 0; x < x_end; x += 16) {
+            __m128i acc = zero;
+            for (int r = 0; r < 8; r++) {
+                const __m128i v = _mm_loadu_si128((const __m128i *)(s + r * stride + x));
+                const __m128i bit = _mm_set1_epi8(char(1 << r));
+                acc = _mm_or_si128(acc, _mm_andnot_si128(_mm_cmpeq_epi8(v, zero), bit));
+            }
+            _mm_storeu_si128((__m128i *)(d + x), acc);
+        }
+
+        rows8_page_portable(s, stride, d, x_end, cols);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2
+//
+// Same as SSE2, but the unpacks work within 128-bit lanes, so put page p in
+// the low lane and page p+1 in the high lane and do two pages at once.
+
+__attribute__((target("avx2")))
+static void rows1_avx2(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const int groups = cols / 128;
+    int p = 0;
+
+    for (; p + 1 < pages; p += 2) {
+        const uint8_t *s = src + p * 8 * stride;
+        const uint8_t *s_hi = s + 8 * stride;
+        uint8_t *d = dst + p * cols;
+        uint8_t *d_hi = d + cols;
+
+        for (int g = 0; g < groups; g++) {
+            __m256i r[8];
+            for (int i = 0; i < 8; i++) {
+                const __m128i lo = _mm_loadu_si128((const __m128i *)(s + i * stride + g * 16));
+                const __m128i hi = _mm_loadu_si128((const __m128i *)(s_hi + i * stride + g * 16));
+                r[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            }
+
+            const __m256i a0 = _mm256_unpacklo_epi8(r[0], r[1]);
+            const __m256i a1 = _mm256_unpackhi_epi8(r[0], r[1]);
+            const __m256i a2 = _mm256_unpacklo_epi8(r[2], r[3]);
+            const __m256i a3 = _mm256_unpackhi_epi8(r[2], r[3]);
+            const __m256i a4 = _mm256_unpacklo_epi8(r[4], r[5]);
+            const __m256i a5 = _mm256_unpackhi_epi8(r[4], r[5]);
+            const __m256i a6 = _mm256_unpacklo_epi8(r[6], r[7]);
+            const __m256i a7 = _mm256_unpackhi_epi8(r[6], r[7]);
+
+            const __m256i b0 = _mm256_unpacklo_epi16(a0, a2);
+            const __m256i b1 = _mm256_unpackhi_epi16(a0, a2);
+            const __m256i b2 = _mm256_unpacklo_epi16(a1, a3);
+            const __m256i b3 = _mm256_unpackhi_epi16(a1, a3);
+            const __m256i b4 = _mm256_unpacklo_epi16(a4, a6);
+            const __m256i b5 = _mm256_unpackhi_epi16(a4, a6);
+            const __m256i b6 = _mm256_unpacklo_epi16(a5, a7);
+            const __m256i b7 = _mm256_unpackhi_epi16(a5, a7);
+
+            __m256i blk[8] = {
+                _mm256_unpacklo_epi32(b0, b4), _mm256_unpackhi_epi32(b0, b4),
+                _mm256_unpacklo_epi32(b1, b5), _mm256_unpackhi_epi32(b1, b5),
+                _mm256_unpacklo_epi32(b2, b6), _mm256_unpackhi_epi32(b2, b6),
+                _mm256_unpacklo_epi32(b3, b7), _mm256_unpackhi_epi32(b3, b7),
+            };
+
+            for (int j = 0; j < 8; j++) {
+                __m256i v = blk[j];
+                uint8_t *o = d + g * 128 + j * 16;
+                uint8_t *o_hi = d_hi + g * 128 + j * 16;
+                for (int c = 0; c < 8; c++) {
+                    const uint32_t m = _mm256_movemask_epi8(v);
+                    o[c] = uint8_t(m);
+                    o[8 + c] = uint8_t(m >> 8);
+                    o_hi[c] = uint8_t(m >> 16);
+                    o_hi[8 + c] = uint8_t(m >> 24);
+                    v = _mm256_add_epi8(v, v);
+                }
+            }
+        }
+
+        rows1_page_portable(s, stride, d, groups * 16, cols / 8);
+        rows1_page_portable(s_hi, stride, d_hi, groups * 16, cols / 8);
+    }
+
+    if (p < pages)
+        rows1_sse2(src + p * 8 * stride, stride, dst + p * cols, cols, 1);
+}
+
+
+__attribute__((target("avx2")))
+static void rows8_avx2(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const int x_end = cols & ~31;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t *s = src + p * 8 * stride;
+        uint8_t *d = dst + p * cols;
+
+        for (int x = 0; x < x_end; x += 32) {
+            __m256i acc = zero;
+            for (int r = 0; r < 8; r++) {
+                const __m256i v = _mm256_loadu_si256((const __m256i *)(s + r * stride + x));
+                const __m256i bit = _mm256_set1_epi8(char(1 << r));
+                acc = _mm256_or_si256(acc, _mm256_andnot_si256(_mm256_cmpeq_epi8(v, zero), bit));
+            }
+            _mm256_storeu_si256((__m256i *)(d + x), acc);
+        }
+
+        rows8_page_portable(s, stride, d, x_end, cols);
+    }
+}
+
+#endif // __x86_64__
+
+
+#if defined(__ARM_NEON)
+
+////////////////////////////////////////////////////////////////////////////////
+// NEON
+//
+// 1 bpp: the same byte/halfword/word interleave as SSE2 (vzip), leaving two
+// blocks per register as two 64-bit lanes, then the portable delta swaps on
+// both lanes at once. vrev64 does the byte reversal, and the result is 16
+// contiguous output columns.
+//
+// 8 bpp: 16 columns at a time, vtst gives all-ones wherever row r is nonzero.
+
+static inline uint64x2_t delta_swap(uint64x2_t x, int shift, uint64_t mask)
+{
+    const uint64x2_t m = vdupq_n_u64(mask);
+    uint64x2_t t;
+    switch (shift) {
+        case 7:
+            t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 7)), m);
+            return veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 7)));
+        case 14:
+            t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 14)), m);
+            return veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 14)));
+        default:
+            t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 28)), m);
+            return veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 28)));
+    }
+}
+
+
+static void rows1_neon(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const int groups = cols / 128;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t *s = src + p * 8 * stride;
+        uint8_t *d = dst + p * cols;
+
+        for (int g = 0; g < groups; g++) {
+            uint8x16_t r[8];
+            for (int i = 0; i < 8; i++)
+                r[i] = vld1q_u8(s + i * stride + g * 16);
+
+            const uint8x16x2_t a01 = vzipq_u8(r[0], r[1]);
+            const uint8x16x2_t a23 = vzipq_u8(r[2], r[3]);
+            const uint8x16x2_t a45 = vzipq_u8(r[4], r[5]);
+            const uint8x16x2_t a67 = vzipq_u8(r[6], r[7]);
+
+            // [0] is blocks 0-3 (or 8-11), [1] is blocks 4-7 (or 12-15)
+            const uint16x8x2_t b02 = vzipq_u16(vreinterpretq_u16_u8(a01.val[0]),
+                                               vreinterpretq_u16_u8(a23.val[0]));
+            const uint16x8x2_t b13 = vzipq_u16(vreinterpretq_u16_u8(a01.val[1]),
+                                               vreinterpretq_u16_u8(a23.val[1]));
+            const uint16x8x2_t b46 = vzipq_u16(vreinterpretq_u16_u8(a45.val[0]),
+                                               vreinterpretq_u16_u8(a67.val[0]));
+            const uint16x8x2_t b57 = vzipq_u16(vreinterpretq_u16_u8(a45.val[1]),
+                                               vreinterpretq_u16_u8(a67.val[1]));
+
+            const uint32x4x2_t c[4] = {
+                vzipq_u32(vreinterpretq_u32_u16(b02.val[0]), vreinterpretq_u32_u16(b46.val[0])),
+                vzipq_u32(vreinterpretq_u32_u16(b02.val[1]), vreinterpretq_u32_u16(b46.val[1])),
+                vzipq_u32(vreinterpretq_u32_u16(b13.val[0]), vreinterpretq_u32_u16(b57.val[0])),
+                vzipq_u32(vreinterpretq_u32_u16(b13.val[1]), vreinterpretq_u32_u16(b57.val[1])),
+            };
+
+            for (int j = 0; j < 8; j++) {
+                uint64x2_t x = vreinterpretq_u64_u32(c[j / 2].val[j % 2]);
+                x = delta_swap(x, 7, 0x00aa00aa00aa00aaull);
+                x = delta_swap(x, 14, 0x0000cccc0000ccccull);
+                x = delta_swap(x, 28, 0x00000000f0f0f0f0ull);
+                vst1q_u8(d + g * 128 + j * 16, vrev64q_u8(vreinterpretq_u8_u64(x)));
+            }
+        }
+
+        rows1_page_portable(s, stride, d, groups * 16, cols / 8);
+    }
+}
+
+
+static void rows8_neon(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    const int x_end = cols & ~15;
+
+    for (int p = 0; p < pages; p++) {
+        const uint8_t *s = src + p * 8 * stride;
+        uint8_t *d = dst + p * cols;
+
+        for (int x = 0; x < x_end; x += 16) {
+            uint8x16_t acc = vdupq_n_u8(0);
+            for (int r = 0; r < 8; r++) {
+                const uint8x16_t v = vld1q_u8(s + r * stride + x);
+                acc = vorrq_u8(acc, vandq_u8(vtstq_u8(v, v), vdupq_n_u8(1 << r)));
+            }
+            vst1q_u8(d + x, acc);
+        }
+
+        rows8_page_portable(s, stride, d, x_end, cols);
+    }
+}
+
+#endif // __ARM_NEON
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Selection
+
+typedef void (*ToPages)(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages);
+
+struct Kernels {
+    Transpose impl;
+    ToPages rows1;
+    ToPages rows8;
+};
+
+static const Kernels kernels[] = {
+    { Transpose::Portable, rows1_portable, rows8_portable },
+#if defined(__x86_64__)
+    { Transpose::Sse2, rows1_sse2, rows8_sse2 },
+    { Transpose::Avx2, rows1_avx2, rows8_avx2 },
+#endif
+#if defined(__ARM_NEON)
+    { Transpose::Neon, rows1_neon, rows8_neon },
+#endif
+};
+
+
+static bool supported(Transpose impl)
+{
+#if defined(__x86_64__)
+    if (impl == Transpose::Avx2)
+        return __builtin_cpu_supports("avx2");
+#endif
+    for (const Kernels& k : kernels)
+        if (k.impl == impl)
+            return true;
+    return false;
+}
+
+
+static const Kernels *find(Transpose impl)
+{
+    if (impl == Transpose::Auto) {
+        // best first
+        const Transpose order[] = {
+            Transpose::Avx2, Transpose::Neon, Transpose::Sse2, Transpose::Portable
+        };
+        for (Transpose t : order)
+            if (supported(t))
+                return find(t);
+        return &kernels[0];
+    }
+
+    if (!supported(impl))
+        return nullptr;
+
+    for (const Kernels& k : kernels)
+        if (k.impl == impl)
+            return &k;
+
+    return nullptr;
+}
+
+
+static std::atomic<const Kernels *> selected(nullptr);
+
+
+static const Kernels *current()
+{
+    const Kernels *k = selected.load(std::memory_order_relaxed);
+    if (k == nullptr) {
+        k = find(Transpose::Auto);
+        selected.store(k, std::memory_order_relaxed);
+    }
+    return k;
+}
+
+
+bool transpose_select(Transpose impl)
+{
+    const Kernels *k = find(impl);
+    if (k == nullptr)
+        return false;
+    selected.store(k, std::memory_order_relaxed);
+    return true;
+}
+
+
+Transpose transpose_selected()
+{
+    return current()->impl;
+}
+
+
+const char *transpose_name(Transpose impl)
+{
+    switch (impl) {
+        case Transpose::Auto: return "auto";
+        case Transpose::Portable: return "portable";
+        case Transpose::Sse2: return "sse2";
+        case Transpose::Avx2: return "avx2";
+        case Transpose::Neon: return "neon";
+    }
+    return "?";
+}
+
+
+void rows1_to_pages(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    if (cols % 8 != 0)
+        OLED_INVALID("rows1_to_pages: cols not a multiple of 8");
+
+    current()->rows1(src, stride, dst, cols, pages);
+}
+
+
+void rows8_to_pages(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages)
+{
+    current()->rows8(src, stride, dst, cols, pages);
+}
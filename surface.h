@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+
+
+// Row-major drawing surfaces
+//
+// Most rasterizers and image code produce bitmaps one row after another,
+// left to right. The SSD1306 wants page-major data instead: one byte is 8
+// vertical pixels (LSB on top), and a page is 8 rows of such bytes. These
+// surfaces let code draw the usual way, then Ssd1306_128x64::blit() converts
+// the whole thing to page layout in one go.
+//
+// Surface1 is 1 bit per pixel, MSB first (the leftmost pixel of a byte is
+// bit 7), each row padded to a whole number of bytes. That is the PBM (P4)
+// layout, so a PBM body can be copied straight in.
+//
+// Surface8 is 1 byte per pixel; any nonzero byte is a lit pixel. That is
+// what a grayscale rasterizer produces, thresholded at zero.
+
+class Surface1
+{
+  public:
+
+    Surface1(int width, int height);
+    ~Surface1();
+
+    Surface1(const Surface1&) = delete;
+    Surface1& operator=(const Surface1&) = delete;
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    int stride() const { return _stride; }
+
+    uint8_t *data() { return _buf; }
+    const uint8_t *data() const { return _buf; }
+
+    uint8_t *row(int y) { return _buf + y * _stride; }
+    const uint8_t *row(int y) const { return _buf + y * _stride; }
+
+    void clear();
+
+    // no range checks; callers are expected to stay inside the surface
+    void set(int x, int y, int d=1)
+    {
+        const uint8_t b = 0x80 >> (x % 8);
+        if (d)
+            row(y)[x / 8] |= b;
+        else
+            row(y)[x / 8] &= ~b;
+    }
+
+    int get(int x, int y) const
+    {
+        return (row(y)[x / 8] >> (7 - x % 8)) & 1;
+    }
+
+  private:
+
+    int _width;
+    int _height;
+    int _stride;
+    uint8_t *_buf;
+};
+
+
+class Surface8
+{
+  public:
+
+    Surface8(int width, int height);
+    ~Surface8();
+
+    Surface8(const Surface8&) = delete;
+    Surface8& operator=(const Surface8&) = delete;
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    int stride() const { return _width; }
+
+    uint8_t *data() { return _buf; }
+    const uint8_t *data() const { return _buf; }
+
+    uint8_t *row(int y) { return _buf + y * _width; }
+    const uint8_t *row(int y) const { return _buf + y * _width; }
+
+    void clear();
+
+    // no range checks; callers are expected to stay inside the surface
+    void set(int x, int y, uint8_t v=0xff) { row(y)[x] = v; }
+
+    uint8_t get(int x, int y) const { return row(y)[x]; }
+
+  private:
+
+    int _width;
+    int _height;
+    uint8_t *_buf;
+};
+
+
+// Row-major to page-major conversion
+//
+// Each 8x8 pixel block of a 1 bpp surface is 8 bytes, one per row; the page
+// layout wants the same block as 8 bytes, one per column. That is an 8x8
+// bit-matrix transpose. There are several implementations; the fastest one
+// the cpu supports is picked the first time a conversion runs, and
+// transpose_select() can override that (e.g. to compare them).
+//
+// src points at the top-left pixel, stride is bytes from one row to the
+// next, dst gets 'pages' runs of 'cols' bytes. cols must be a multiple of 8.
+
+enum class Transpose {
+    Auto,       // best available
+    Portable,   // plain C++, 64-bit delta swaps
+    Sse2,       // x86-64
+    Avx2,       // x86-64 with avx2, two pages at a time
+    Neon,       // arm with neon
+};
+
+// returns false (and changes nothing) if impl is not supported here
+bool transpose_select(Transpose impl);
+
+// what is currently in use (never Auto)
+Transpose transpose_selected();
+
+const char *transpose_name(Transpose impl);
+
+void rows1_to_pages(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages);
+
+void rows8_to_pages(const uint8_t *src, int stride, uint8_t *dst, int cols, int pages);
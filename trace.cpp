@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <cstdio>
+
+#include "trace.h"
+
+#if defined(OLED_TRACE)
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+namespace {
+
+struct Event {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int nargs;
+    const char *keys[2];
+    int32_t vals[2];
+};
+
+
+// One per thread; only that thread writes, trace_write() reads
+struct Ring {
+    static const uint32_t size = 16384; // power of 2
+
+    int tid;
+    std::atomic<uint64_t> head;  // events ever written
+    Event events[size];
+};
+
+
+std::mutex rings_mutex;
+std::vector<Ring *> rings;  // never freed, so a trace can outlive its threads
+
+
+Ring *my_ring()
+{
+    static thread_local Ring *ring = nullptr;
+
+    if (ring == nullptr) {
+        ring = new Ring;
+        ring->tid = int(syscall(SYS_gettid));
+        ring->head.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(ring);
+    }
+
+    return ring;
+}
+
+
+uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+} // namespace
+
+
+TraceScope::TraceScope(const char *name) :
+    _name(name),
+    _start_ns(now_ns()),
+    _nargs(0)
+{
+}
+
+
+TraceScope::~TraceScope()
+{
+    const uint64_t end_ns = now_ns();
+
+    Ring *ring = my_ring();
+    const uint64_t h = ring->head.load(std::memory_order_relaxed);
+    Event& e = ring->events[h & (Ring::size - 1)];
+    e.name = _name;
+    e.start_ns = _start_ns;
+    e.dur_ns = end_ns - _start_ns;
+    e.nargs = _nargs;
+    for (int i = 0; i < _nargs; i++) {
+        e.keys[i] = _keys[i];
+        e.vals[i] = _vals[i];
+    }
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+
+bool trace_write(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == nullptr)
+        return false;
+
+    const int pid = getpid();
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (const Ring *ring : rings) {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t n = (head < Ring::size) ? head : Ring::size;
+        for (uint64_t i = head - n; i < head; i++) {
+            const Event& e = ring->events[i & (Ring::size - 1)];
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f",
+                    first ? "" : ",\n", e.name, pid, ring->tid,
+                    e.start_ns / 1000.0, e.dur_ns / 1000.0);
+            if (e.nargs > 0) {
+                fprintf(f, ",\"args\":{");
+                for (int a = 0; a < e.nargs; a++)
+                    fprintf(f, "%s\"%s\":%d", a ? "," : "", e.keys[a], int(e.vals[a]));
+                fprintf(f, "}");
+            }
+            fprintf(f, "}");
+            first = false;
+        }
+    }
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    return fclose(f) == 0;
+}
+
+
+void trace_clear()
+{
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (Ring *ring : rings)
+        ring->head.store(0, std::memory_order_release);
+}
+
+#else // !OLED_TRACE
+
+bool trace_write(const char *)
+{
+    return false;
+}
+
+
+void trace_clear()
+{
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+
+// Timeline tracing
+//
+// Built with OLED_TRACE=ON (cmake), drawing calls, flushes, window commands
+// and every i2c ioctl are recorded with start time, duration and a couple
+// of numbers (bytes, tries, ...). trace_write() saves them in Chrome trace
+// format, which chrome://tracing and ui.perfetto.dev load; a late frame
+// shows up as a long flush with the ioctls inside it.
+//
+// Each thread records into its own ring buffer with no locking (the ring is
+// registered once, the first time the thread records anything). A full ring
+// overwrites its oldest events. Write the trace while things are quiet:
+// events being recorded during trace_write() may come out garbled.
+//
+// Built without OLED_TRACE, the macros are empty, so traced code compiles to
+// exactly what it was, and trace_write() just returns false.
+//
+//   void Thing::work(int n)
+//   {
+//       OLED_TRACE_SCOPE(t, "work");   // ends when t goes out of scope
+//       OLED_TRACE_ARG(t, "n", n);     // up to two per scope
+//       ...
+//   }
+
+#if defined(OLED_TRACE)
+
+class TraceScope
+{
+  public:
+
+    TraceScope(const char *name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    // key must be a string literal (only the pointer is kept)
+    void arg(const char *key, int32_t value)
+    {
+        if (_nargs < 2) {
+            _keys[_nargs] = key;
+            _vals[_nargs] = value;
+            _nargs++;
+        }
+    }
+
+  private:
+
+    const char *_name;
+    uint64_t _start_ns;
+    int _nargs;
+    const char *_keys[2];
+    int32_t _vals[2];
+};
+
+#define OLED_TRACE_SCOPE(var, name) TraceScope var(name)
+#define OLED_TRACE_ARG(var, key, value) var.arg(key, int32_t(value))
+
+#else
+
+#define OLED_TRACE_SCOPE(var, name)
+#define OLED_TRACE_ARG(var, key, value)
+
+#endif
+
+
+// Write everything recorded so far as Chrome trace JSON; false on error or
+// if tracing isn't built in
+bool trace_write(const char *path);
+
+// Forget everything recorded so far (call while nothing is recording)
+void trace_clear();